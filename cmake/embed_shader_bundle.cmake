@@ -0,0 +1,40 @@
+# Writes a C++ source that embeds precompiled Slang modules into vulkan_engine.
+# Usage: cmake -DOUTPUT=<file.cpp> -DMODULE_NAMES=<a|b> -DMODULE_FILES=<a.slang-module|b.slang-module> -P embed_shader_bundle.cmake
+
+string(REPLACE "|" ";" MODULE_NAMES "${MODULE_NAMES}")
+string(REPLACE "|" ";" MODULE_FILES "${MODULE_FILES}")
+
+set(arrays "")
+set(entries "")
+
+foreach(name file IN ZIP_LISTS MODULE_NAMES MODULE_FILES)
+    file(READ ${file} contents HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${contents}")
+    string(APPEND arrays "alignas(16) const unsigned char ${name}_ir[] = { ${bytes} };\n")
+    string(APPEND entries "    { \"${name}\", ${name}_ir, sizeof(${name}_ir) },\n")
+endforeach()
+
+file(WRITE ${OUTPUT}.tmp
+"// Generated by cmake/embed_shader_bundle.cmake, do not edit
+#include <shader_bundle.hpp>
+
+namespace vkengine {
+
+namespace {
+
+${arrays}
+const embedded_shader_module modules[] = {
+${entries}};
+
+}
+
+std::span<const embedded_shader_module> embedded_shader_modules() {
+    return modules;
+}
+
+}
+")
+
+# Only touch the output when it changed so that unrelated shader edits do not relink everything
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithms/histogram.hpp>
+#include <algorithms/inclusive_scan.hpp>
+#include <algorithms/median_filter.hpp>
+#include <algorithms/normalise.hpp>
+#include <workgroup_autotuner.hpp>
+
+namespace vkengine {
+
+struct operator_tuning_options {
+	// Every candidate is timed on all of these, and the one with the lowest total wins
+	std::vector<std::array<uint32_t, 2>>	image_shapes = { { 1080, 1920 }, { 2160, 3840 } };
+	uint32_t								repetitions = 7;
+};
+
+// Tunes the workgroup size of every operator on this device and stores the results in the shader manager's
+// workgroup_tuning. Operators constructed afterwards, and in later runs on the same device and driver, use them.
+inline void tune_operators(
+	vulkan_core&					core,
+	allocator&						alloc,
+	shader_manager&					shader_manager,
+	const operator_tuning_options&	options = {}
+) {
+	workgroup_autotuner autotuner(core, shader_manager, options.repetitions);
+	auto gpu = core.gpu();
+
+	std::vector<device_buffer_nd<uint16_t, 2>> images;
+	std::vector<device_buffer_nd<uint16_t, 2>> filtered_images;
+	std::vector<device_buffer<uint32_t>> values;
+	std::vector<device_buffer<uint16_t>> normalised_values;
+
+	for (const auto& shape : options.image_shapes) {
+		images.emplace_back(alloc, core, shape);
+		filtered_images.emplace_back(alloc, core, shape);
+		values.emplace_back(alloc, core, shape[0] * shape[1]);
+		normalised_values.emplace_back(alloc, core, shape[0] * shape[1]);
+	}
+
+	// Sized for every possible uint16_t value, the tuning images are not initialised
+	device_buffer<uint32_t> histogram(alloc, core, 1u << 16);
+
+	autotuner.tune(histogram_operator<>::TUNING_KEY, histogram_operator<>::tuning_candidates(gpu),
+		[&](vk::CommandBuffer cmd_buffer, workgroup_size size) {
+			histogram_operator<uint16_t> op(shader_manager, size);
+			for (auto& image : images)
+				op.record(cmd_buffer, image, histogram);
+		});
+
+	autotuner.tune(median_filter_operator<>::TUNING_KEY, median_filter_operator<>::tuning_candidates(gpu),
+		[&](vk::CommandBuffer cmd_buffer, workgroup_size size) {
+			median_filter_operator<uint16_t> op(shader_manager, size);
+			for (auto [image, filtered] : std::views::zip(images, filtered_images))
+				op.record(image, filtered, cmd_buffer);
+		});
+
+	autotuner.tune(NORMALISE_TUNING_KEY, normalise_tuning_candidates(gpu),
+		[&](vk::CommandBuffer cmd_buffer, workgroup_size size) {
+			for (auto [input, output] : std::views::zip(values, normalised_values))
+				normalise<uint32_t, uint16_t>(input, output, 0u, 1u << 20, uint16_t(0), uint16_t(65535), shader_manager, cmd_buffer, size);
+		});
+
+	// The group sums are scanned by a single subgroup, which limits a scan to subgroup size squared elements
+	uint32_t subgroup_size = gpu.subgroup_properties.subgroupSize;
+	device_buffer<uint32_t> scan_input(alloc, core, subgroup_size * subgroup_size);
+	device_buffer<uint32_t> scan_output(alloc, core, subgroup_size * subgroup_size);
+	device_buffer<uint32_t> group_sums(alloc, core, subgroup_size);
+
+	autotuner.tune(INCLUSIVE_SCAN_TUNING_KEY, inclusive_scan_tuning_candidates(gpu),
+		[&](vk::CommandBuffer cmd_buffer, workgroup_size size) {
+			inclusive_scan(scan_input, scan_output, group_sums, shader_manager, cmd_buffer, size);
+		});
+}
+
+}
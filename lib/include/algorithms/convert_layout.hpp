@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithms/dispatch.hpp>
+#include <algorithms/types.hpp>
+#include <detailed_exception.hpp>
+#include <typed_buffer.hpp>
+
+namespace vkengine {
+
+constexpr uint32_t CONVERT_LAYOUT_WORKGROUP_SIZE_X = 16;
+constexpr uint32_t CONVERT_LAYOUT_WORKGROUP_SIZE_Y = 16;
+
+struct convert_layout_push_constants {
+	device_mdspan<2> input;
+	device_mdspan<2> output;
+};
+
+template<pixel_type T>
+shader_manager::program_compile_info convert_layout_program_info(buffer_layout input_layout, buffer_layout output_layout) {
+	shader_manager::source_module workgroup_module = {
+		.name = "workgroup_module",
+		.source = fmt::format(
+			"export static const uint CONVERT_LAYOUT_WORKGROUP_SIZE_X = {};"
+			"export static const uint CONVERT_LAYOUT_WORKGROUP_SIZE_Y = {};",
+			CONVERT_LAYOUT_WORKGROUP_SIZE_X, CONVERT_LAYOUT_WORKGROUP_SIZE_Y
+		)
+	};
+
+	return shader_manager::program_compile_info {
+		.module_name = std::string(VKENGINE_SHADER_DIR) + "/convert_layout.slang",
+		.entry_points = {
+			shader_manager::entry_point_compile_info {
+				.name = "convert_layout",
+				.specialisation_type_names = { type_name<T>::value, layout_type_name(input_layout), layout_type_name(output_layout) }
+			}
+		},
+		.modules = { workgroup_module }
+	};
+}
+
+// Copies a 2D buffer into a buffer of another layout, e.g. a linear frame into a tiled one before a chain of
+// stencil operators, and back for readback
+template<pixel_type T, access_policy input_policy, access_policy output_policy, buffer_layout input_layout, buffer_layout output_layout>
+void convert_layout(
+	typed_buffer<T, 2, input_policy, buffer_kind::storage, input_layout>& input,
+	typed_buffer<T, 2, output_policy, buffer_kind::storage, output_layout>& output,
+	shader_manager& shader_manager,
+	compute_recorder& recorder
+) {
+	if (input.shape() != output.shape())
+		throw detailed_exception("Input and output must have the same shape");
+	require_pixel_type<T>(shader_manager.gpu());
+
+	auto shader_program = shader_manager.load_shader(convert_layout_program_info<T>(input_layout, output_layout));
+
+	convert_layout_push_constants push_constants = {
+		.input = input.as_mdspan(),
+		.output = output.as_mdspan()
+	};
+
+	dispatch_shader(
+		recorder,
+		shader_program->entry_points[0],
+		group_counts_2d(input.shape(), CONVERT_LAYOUT_WORKGROUP_SIZE_X, CONVERT_LAYOUT_WORKGROUP_SIZE_Y),
+		vk::ShaderStageFlagBits::eCompute,
+		push_constants
+	);
+}
+
+template<pixel_type T, access_policy input_policy, access_policy output_policy, buffer_layout input_layout, buffer_layout output_layout>
+void convert_layout(
+	typed_buffer<T, 2, input_policy, buffer_kind::storage, input_layout>& input,
+	typed_buffer<T, 2, output_policy, buffer_kind::storage, output_layout>& output,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer
+) {
+	compute_recorder recorder(cmd_buffer);
+	convert_layout(input, output, shader_manager, recorder);
+}
+
+}
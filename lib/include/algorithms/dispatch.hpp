@@ -1,6 +1,15 @@
 #pragma once
 
 #include <vulkan/vulkan_handles.hpp>
+#include <compute_recorder.hpp>
+#include <detailed_exception.hpp>
+#include <shader_manager.hpp>
+#include <typed_buffer.hpp>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <span>
 #include <vector>
 #include <cstring>
 
@@ -8,29 +17,108 @@ namespace vkengine {
 
 constexpr uint32_t VULKAN_PUSH_CONSTANT_SIZE_LIMIT = 128;
 
-void dispatch_shader_impl(
+// Buffer of VkDispatchIndirectCommand that shaders can write, e.g. with compute_dispatch_args
+template<access_policy policy = access_policy::device>
+using dispatch_args_buffer = typed_buffer<vk::DispatchIndirectCommand, 1, policy, buffer_kind::indirect>;
+
+// Matches DISPATCH_FOLD_WIDTH in span.slang, the smallest maxComputeWorkGroupCount Vulkan allows
+constexpr uint32_t DISPATCH_FOLD_WIDTH = 65535;
+
+// 1D dispatches with more groups than DISPATCH_FOLD_WIDTH are folded into rows, and rows into slices, so that
+// elementwise kernels cover large buffers in a single dispatch. Kernels recover the 1D index with linear_group_index or
+// linear_thread_index from span.slang and must bounds check it, the last row is padded.
+constexpr std::array<uint32_t, 3> fold_group_counts(const std::array<uint32_t, 3>& group_counts) {
+    if (group_counts[1] != 1 || group_counts[2] != 1 || group_counts[0] <= DISPATCH_FOLD_WIDTH)
+        return group_counts;
+
+    // Rounded up without overflowing near 4 G groups
+    uint32_t rows = group_counts[0] / DISPATCH_FOLD_WIDTH + (group_counts[0] % DISPATCH_FOLD_WIDTH != 0);
+    if (rows <= DISPATCH_FOLD_WIDTH)
+        return { DISPATCH_FOLD_WIDTH, rows, 1 };
+
+    return { DISPATCH_FOLD_WIDTH, DISPATCH_FOLD_WIDTH, (rows + DISPATCH_FOLD_WIDTH - 1) / DISPATCH_FOLD_WIDTH };
+}
+
+static_assert(fold_group_counts({ DISPATCH_FOLD_WIDTH, 1, 1 }) == std::array<uint32_t, 3>{ DISPATCH_FOLD_WIDTH, 1, 1 });
+static_assert(fold_group_counts({ DISPATCH_FOLD_WIDTH + 1, 1, 1 }) == std::array<uint32_t, 3>{ DISPATCH_FOLD_WIDTH, 2, 1 });
+static_assert(fold_group_counts({ 2 * DISPATCH_FOLD_WIDTH + 1, 1, 1 }) == std::array<uint32_t, 3>{ DISPATCH_FOLD_WIDTH, 3, 1 });
+static_assert(fold_group_counts({ 70000, 2, 1 }) == std::array<uint32_t, 3>{ 70000, 2, 1 });
+static_assert(fold_group_counts({ DISPATCH_FOLD_WIDTH * DISPATCH_FOLD_WIDTH + 1, 1, 1 })
+    == std::array<uint32_t, 3>{ DISPATCH_FOLD_WIDTH, DISPATCH_FOLD_WIDTH, 2 });
+static_assert(fold_group_counts({ std::numeric_limits<uint32_t>::max(), 1, 1 })
+    == std::array<uint32_t, 3>{ DISPATCH_FOLD_WIDTH, DISPATCH_FOLD_WIDTH, 2 });
+
+// Elementwise kernels process VECTOR_WIDTH elements per thread with load4 / store4 (see span.slang) when every span
+// they access is aligned to VECTOR_WIDTH elements, and one element per thread otherwise
+constexpr uint32_t VECTOR_WIDTH = 4;
+
+template<typename T>
+constexpr bool is_vector_aligned(vk::DeviceAddress address) {
+    return address % (VECTOR_WIDTH * sizeof(T)) == 0;
+}
+
+// Groups covering a 2D shape of { rows, columns }, one thread per element. 2D dispatches are not folded.
+inline std::array<uint32_t, 3> group_counts_2d(const std::array<uint32_t, 2>& shape, uint32_t workgroup_size_x, uint32_t workgroup_size_y = 1) {
+    std::array<uint32_t, 3> group_counts = {
+        (shape[1] + workgroup_size_x - 1) / workgroup_size_x,
+        (shape[0] + workgroup_size_y - 1) / workgroup_size_y,
+        1
+    };
+    if (group_counts[0] > DISPATCH_FOLD_WIDTH || group_counts[1] > DISPATCH_FOLD_WIDTH)
+        throw detailed_exception("{}x{} elements need more than {} workgroups in a dimension", shape[0], shape[1], DISPATCH_FOLD_WIDTH);
+    return group_counts;
+}
+
+// Groups of 'workgroup_size' threads covering 'items', one thread each
+inline uint32_t group_count_1d(uint64_t items, uint32_t workgroup_size) {
+    uint64_t groups = (items + workgroup_size - 1) / workgroup_size;
+    if (groups > std::numeric_limits<uint32_t>::max())
+        throw detailed_exception("{} items need more than 4 G workgroups of {}", items, workgroup_size);
+    return static_cast<uint32_t>(groups);
+}
+
+// Whether thread indices of a 1D dispatch, including the padding of its last folded row, can reach 4 G.
+// Kernels taking LARGE_INDICES switch to 64-bit index math then.
+inline bool needs_64bit_thread_indices(uint32_t group_count, uint32_t workgroup_size) {
+    auto folded = fold_group_counts({ group_count, 1, 1 });
+    uint64_t threads = uint64_t(folded[0]) * folded[1] * folded[2] * workgroup_size;
+    return threads > std::numeric_limits<uint32_t>::max();
+}
+
+// LARGE_INDICES for a 1D dispatch. The 64-bit index math needs shaderInt64, without it LARGE_INDICES stays false
+// and dispatches that would need it are rejected.
+inline bool large_thread_indices(const gpu& gpu, uint32_t group_count, uint32_t workgroup_size) {
+    if (!needs_64bit_thread_indices(group_count, workgroup_size))
+        return false;
+    if (!gpu.features.features.shaderInt64)
+        throw detailed_exception("{} groups of {} need 64-bit thread indices, which {} does not support",
+            group_count, workgroup_size, gpu.properties.properties.deviceName.data());
+    return true;
+}
+
+inline void dispatch_shader_impl(
     vk::CommandBuffer cmd,
     const shader_entry_point& shader,
     const std::array<uint32_t, 3>& group_counts,
     vk::ShaderStageFlagBits shader_stage_flags
 ) {
+    auto folded_counts = fold_group_counts(group_counts);
+
     cmd.bindShadersEXT(shader_stage_flags, { shader.shader_ext });
-    cmd.dispatch(group_counts[0], group_counts[1], group_counts[2]);
+    cmd.dispatch(folded_counts[0], folded_counts[1], folded_counts[2]);
 }
 
 template<typename TPushConstants>
-void dispatch_shader(
+void push_shader_constants(
     vk::CommandBuffer cmd,
     const shader_entry_point& shader,
-    const std::array<uint32_t, 3>& group_counts,
-    vk::ShaderStageFlagBits shader_stage_flags,
     const TPushConstants& push_constants
 ) {
     static_assert(std::is_trivially_copyable_v<TPushConstants>,
         "Push constants must be trivially copyable.");
     static_assert(sizeof(TPushConstants) <= VULKAN_PUSH_CONSTANT_SIZE_LIMIT,
         "Push constants size exceeds Vulkan limit.");
-    assert(sizeof(TPushConstants) == shader.push_constant_range.size,
+    assert(sizeof(TPushConstants) == shader.push_constant_range.size &&
         "Push constants size mismatch shader's range.");
 
     cmd.pushConstants(
@@ -40,11 +128,21 @@ void dispatch_shader(
         sizeof(TPushConstants),
         &push_constants
     );
+}
 
+template<typename TPushConstants>
+void dispatch_shader(
+    vk::CommandBuffer cmd,
+    const shader_entry_point& shader,
+    const std::array<uint32_t, 3>& group_counts,
+    vk::ShaderStageFlagBits shader_stage_flags,
+    const TPushConstants& push_constants
+) {
+    push_shader_constants(cmd, shader, push_constants);
     dispatch_shader_impl(cmd, shader, group_counts, shader_stage_flags);
 }
 
-void dispatch_shader(
+inline void dispatch_shader(
     vk::CommandBuffer cmd,
     const shader_entry_point& shader,
     const std::array<uint32_t, 3>& group_counts,
@@ -53,4 +151,113 @@ void dispatch_shader(
     dispatch_shader_impl(cmd, shader, group_counts, shader_stage_flags);
 }
 
-} // namespace vkengine
\ No newline at end of file
+// Group counts are read from args[arg_index] when the dispatch executes, so they can come from an earlier
+// dispatch in the same submission. The writes need a barrier to eDrawIndirect / eIndirectCommandRead first.
+template<access_policy policy>
+void dispatch_shader_indirect_impl(
+    vk::CommandBuffer cmd,
+    const shader_entry_point& shader,
+    const dispatch_args_buffer<policy>& args,
+    uint32_t arg_index,
+    vk::ShaderStageFlagBits shader_stage_flags
+) {
+    assert(arg_index < args.size() && "Indirect dispatch index is out of range.");
+
+    cmd.bindShadersEXT(shader_stage_flags, { shader.shader_ext });
+    cmd.dispatchIndirect(args.vk_handle(), arg_index * sizeof(vk::DispatchIndirectCommand));
+}
+
+template<typename TPushConstants, access_policy policy>
+void dispatch_shader_indirect(
+    vk::CommandBuffer cmd,
+    const shader_entry_point& shader,
+    const dispatch_args_buffer<policy>& args,
+    uint32_t arg_index,
+    vk::ShaderStageFlagBits shader_stage_flags,
+    const TPushConstants& push_constants
+) {
+    push_shader_constants(cmd, shader, push_constants);
+    dispatch_shader_indirect_impl(cmd, shader, args, arg_index, shader_stage_flags);
+}
+
+template<access_policy policy>
+void dispatch_shader_indirect(
+    vk::CommandBuffer cmd,
+    const shader_entry_point& shader,
+    const dispatch_args_buffer<policy>& args,
+    uint32_t arg_index,
+    vk::ShaderStageFlagBits shader_stage_flags
+) {
+    dispatch_shader_indirect_impl(cmd, shader, args, arg_index, shader_stage_flags);
+}
+
+// compute_recorder variants, these skip binds and push constants that are already in place
+
+template<typename TPushConstants>
+void push_shader_constants(
+    compute_recorder& recorder,
+    const shader_entry_point& shader,
+    const TPushConstants& push_constants
+) {
+    static_assert(std::is_trivially_copyable_v<TPushConstants>,
+        "Push constants must be trivially copyable.");
+    static_assert(sizeof(TPushConstants) <= VULKAN_PUSH_CONSTANT_SIZE_LIMIT,
+        "Push constants size exceeds Vulkan limit.");
+
+    recorder.push_constants(shader, std::as_bytes(std::span(&push_constants, 1)));
+}
+
+template<typename TPushConstants>
+void dispatch_shader(
+    compute_recorder& recorder,
+    const shader_entry_point& shader,
+    const std::array<uint32_t, 3>& group_counts,
+    vk::ShaderStageFlagBits shader_stage_flags,
+    const TPushConstants& push_constants
+) {
+    push_shader_constants(recorder, shader, push_constants);
+    recorder.bind_shader(shader, shader_stage_flags);
+    recorder.dispatch(fold_group_counts(group_counts));
+}
+
+inline void dispatch_shader(
+    compute_recorder& recorder,
+    const shader_entry_point& shader,
+    const std::array<uint32_t, 3>& group_counts,
+    vk::ShaderStageFlagBits shader_stage_flags
+) {
+    recorder.bind_shader(shader, shader_stage_flags);
+    recorder.dispatch(fold_group_counts(group_counts));
+}
+
+template<typename TPushConstants, access_policy policy>
+void dispatch_shader_indirect(
+    compute_recorder& recorder,
+    const shader_entry_point& shader,
+    const dispatch_args_buffer<policy>& args,
+    uint32_t arg_index,
+    vk::ShaderStageFlagBits shader_stage_flags,
+    const TPushConstants& push_constants
+) {
+    assert(arg_index < args.size() && "Indirect dispatch index is out of range.");
+
+    push_shader_constants(recorder, shader, push_constants);
+    recorder.bind_shader(shader, shader_stage_flags);
+    recorder.dispatch_indirect(args.vk_handle(), arg_index * sizeof(vk::DispatchIndirectCommand));
+}
+
+template<access_policy policy>
+void dispatch_shader_indirect(
+    compute_recorder& recorder,
+    const shader_entry_point& shader,
+    const dispatch_args_buffer<policy>& args,
+    uint32_t arg_index,
+    vk::ShaderStageFlagBits shader_stage_flags
+) {
+    assert(arg_index < args.size() && "Indirect dispatch index is out of range.");
+
+    recorder.bind_shader(shader, shader_stage_flags);
+    recorder.dispatch_indirect(args.vk_handle(), arg_index * sizeof(vk::DispatchIndirectCommand));
+}
+
+} // namespace vkengine
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithms/dispatch.hpp>
+#include <detailed_exception.hpp>
+#include <shader_manager.hpp>
+#include <typed_buffer.hpp>
+
+namespace vkengine {
+
+struct dispatch_args_push_constants {
+	device_span counts;
+	device_span args;
+	uint32_t count_index;
+	uint32_t arg_index;
+	uint32_t items_per_workgroup;
+};
+
+inline shader_manager::program_compile_info dispatch_args_program_info() {
+	return shader_manager::program_compile_info {
+		.module_name = std::string(VKENGINE_SHADER_DIR) + "/dispatch_args.slang",
+		.entry_points = { shader_manager::entry_point_compile_info { .name = "compute_dispatch_args" } }
+	};
+}
+
+// Writes ceil(counts[count_index] / items_per_workgroup) groups to args[arg_index] on the GPU, folded like
+// dispatch_shader folds 1D dispatches, and makes it visible to indirect dispatches recorded after this. This chains an
+// operator whose size depends on an earlier result (a compacted pixel list, tiles over a threshold, ...) without a readback.
+// Writes to 'counts' must already be visible to compute shader reads.
+template<access_policy policy, access_policy args_policy>
+void compute_dispatch_args(
+	typed_buffer<uint32_t, 1, policy>& counts,
+	uint32_t count_index,
+	dispatch_args_buffer<args_policy>& args,
+	uint32_t arg_index,
+	uint32_t items_per_workgroup,
+	shader_manager& shader_manager,
+	compute_recorder& recorder
+) {
+	if (count_index >= counts.size() || arg_index >= args.size())
+		throw detailed_exception("Dispatch args index is out of range");
+	if (items_per_workgroup == 0)
+		throw detailed_exception("items_per_workgroup must not be zero");
+
+	auto shader_program = shader_manager.load_shader(dispatch_args_program_info());
+
+	dispatch_args_push_constants push_constants = {
+		.counts = counts,
+		.args = args,
+		.count_index = count_index,
+		.arg_index = arg_index,
+		.items_per_workgroup = items_per_workgroup
+	};
+
+	dispatch_shader(
+		recorder,
+		shader_program->entry_points[0],
+		{ 1, 1, 1 },
+		vk::ShaderStageFlagBits::eCompute,
+		push_constants
+	);
+
+	auto args_barrier = vk::BufferMemoryBarrier2()
+		.setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+		.setSrcAccessMask(vk::AccessFlagBits2::eShaderWrite)
+		.setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect)
+		.setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead)
+		.setBuffer(args.vk_handle())
+		.setOffset(arg_index * sizeof(vk::DispatchIndirectCommand))
+		.setSize(sizeof(vk::DispatchIndirectCommand));
+
+	recorder.pipeline_barrier(vk::DependencyInfo().setBufferMemoryBarriers(args_barrier));
+}
+
+template<access_policy policy, access_policy args_policy>
+void compute_dispatch_args(
+	typed_buffer<uint32_t, 1, policy>& counts,
+	uint32_t count_index,
+	dispatch_args_buffer<args_policy>& args,
+	uint32_t arg_index,
+	uint32_t items_per_workgroup,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer
+) {
+	compute_recorder recorder(cmd_buffer);
+	compute_dispatch_args(counts, count_index, args, arg_index, items_per_workgroup, shader_manager, recorder);
+}
+
+}
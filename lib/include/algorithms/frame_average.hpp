@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithms/dispatch.hpp>
+#include <algorithms/types.hpp>
+#include <argument_ring.hpp>
+#include <detailed_exception.hpp>
+#include <workgroup_autotuner.hpp>
+
+namespace vkengine {
+
+constexpr uint32_t FRAME_AVERAGE_WORKGROUP_SIZE_X = 128;
+constexpr const char* FRAME_AVERAGE_TUNING_KEY = "frame_average";
+
+struct frame_average_push_constants {
+	device_span frames;
+	device_span output;
+};
+
+inline workgroup_size frame_average_workgroup_size(shader_manager& shader_manager) {
+	return shader_manager.workgroup_sizes().get(FRAME_AVERAGE_TUNING_KEY, { .x = FRAME_AVERAGE_WORKGROUP_SIZE_X });
+}
+
+template<pixel_type T>
+shader_manager::program_compile_info frame_average_program_info(
+	workgroup_size size = { .x = FRAME_AVERAGE_WORKGROUP_SIZE_X },
+	bool large_indices = false
+) {
+	shader_manager::source_module workgroup_module = {
+		.name = "workgroup_module",
+		.source = fmt::format(
+			"export static const uint FRAME_AVERAGE_WORKGROUP_SIZE_X = {};"
+			"export static const bool LARGE_INDICES = {};",
+			size.x, large_indices
+		)
+	};
+
+	return shader_manager::program_compile_info {
+		.module_name = std::string(VKENGINE_SHADER_DIR) + "/frame_average.slang",
+		.entry_points = {
+			shader_manager::entry_point_compile_info {
+				.name = "frame_average",
+				.specialisation_type_names = { type_name<T>::value }
+			}
+		},
+		.modules = { workgroup_module }
+	};
+}
+
+// Averages any number of frames into output. The frame list goes through the argument ring, so retire() the ring
+// with the timeline value of the submission this is recorded into.
+template<pixel_type T, uint32_t dims, access_policy policy>
+void frame_average(
+	std::span<typed_buffer<T, dims, policy>* const> frames,
+	typed_buffer<T, dims, policy>& output,
+	argument_ring& arguments,
+	shader_manager& shader_manager,
+	compute_recorder& recorder
+) {
+	if (frames.empty())
+		throw detailed_exception("Frame average needs at least one frame");
+	require_pixel_type<T>(shader_manager.gpu());
+
+	std::vector<device_span> frame_spans;
+	frame_spans.reserve(frames.size());
+	for (auto* frame : frames) {
+		if (frame->size() != output.size())
+			throw detailed_exception("Frames and output must be the same size");
+		frame_spans.push_back(frame->as_span());
+	}
+
+	auto size = frame_average_workgroup_size(shader_manager);
+	uint32_t group_count = group_count_1d(output.size(), size.x);
+	auto shader_program = shader_manager.load_shader(
+		frame_average_program_info<T>(size, large_thread_indices(shader_manager.gpu(), group_count, size.x)));
+
+	frame_average_push_constants push_constants = {
+		.frames = arguments.write(std::span<const device_span>(frame_spans)),
+		.output = output
+	};
+
+	dispatch_shader(
+		recorder,
+		shader_program->entry_points[0],
+		{ group_count, 1, 1 },
+		vk::ShaderStageFlagBits::eCompute,
+		push_constants
+	);
+}
+
+template<pixel_type T, uint32_t dims, access_policy policy>
+void frame_average(
+	std::span<typed_buffer<T, dims, policy>* const> frames,
+	typed_buffer<T, dims, policy>& output,
+	argument_ring& arguments,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer
+) {
+	compute_recorder recorder(cmd_buffer);
+	frame_average(frames, output, arguments, shader_manager, recorder);
+}
+
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <algorithms/dispatch.hpp>
+#include <algorithms/types.hpp>
 #include <shader_manager.hpp>
 #include <typed_buffer.hpp>
+#include <workgroup_autotuner.hpp>
 
 namespace vkengine {
 
@@ -11,48 +13,182 @@ constexpr uint32_t HISTOGRAM_WORKGROUP_SIZE_X = 128;
 struct histogram_push_constants {
 	device_span input;
 	device_span histogram;
+	float range_min;
+	float bin_scale;
 };
 
+struct histogram_view_push_constants {
+	device_mdspan<2> input;
+	device_span histogram;
+	float range_min;
+	float bin_scale;
+};
+
+// Values in [min, max) are spread evenly over the histogram bins, values outside land in the first or last bin
+struct histogram_range {
+	float min;
+	float max;
+};
+
+// Integer types default to their full range, so with one bin per value (e.g. 65536 for 16-bit types) every value
+// is counted exactly. Floating point types default to [0, 1).
+template<pixel_type T>
+constexpr histogram_range default_histogram_range() {
+	if constexpr (std::is_integral_v<T>)
+		return { .min = float(std::numeric_limits<T>::lowest()), .max = float(std::numeric_limits<T>::max()) + 1.0f };
+	else
+		return { .min = 0.0f, .max = 1.0f };
+}
+
+template<pixel_type T = uint16_t>
 class histogram_operator {
 public:
-	histogram_operator(shader_manager& shader_manager) {
-		auto workgroup_module = shader_manager.create_shader_module_from_source_string(
-			fmt::format(
-				"export static const uint HISTOGRAM_WORKGROUP_SIZE_X = {};",
-				HISTOGRAM_WORKGROUP_SIZE_X
-			), "workgroup_module");
-
-		histogram_shader_program_ = shader_manager.load_shader(
-			std::string(VKENGINE_SHADER_DIR) + "/histogram.slang",
-			{ shader_manager::entry_point_compile_info {.name = "histogram" } },
-			{ workgroup_module }
-		);
+	static constexpr const char* TUNING_KEY = "histogram";
+	static constexpr workgroup_size DEFAULT_WORKGROUP_SIZE = { .x = HISTOGRAM_WORKGROUP_SIZE_X };
+
+	// With the tuned workgroup size when there is one
+	histogram_operator(shader_manager& shader_manager)
+		: histogram_operator(shader_manager, shader_manager.workgroup_sizes().get(TUNING_KEY, DEFAULT_WORKGROUP_SIZE)) {}
+
+	histogram_operator(shader_manager& shader_manager, workgroup_size size)
+		: shader_manager_(shader_manager), workgroup_size_(size), programs_(shader_manager) {
+		require_pixel_type<T>(shader_manager_.gpu());
+		program(false, 1);
 	}
 
+	static shader_manager::program_compile_info program_info(
+		workgroup_size size = DEFAULT_WORKGROUP_SIZE,
+		bool large_indices = false,
+		uint32_t elements_per_thread = 1
+	) {
+		shader_manager::source_module workgroup_module = {
+			.name = "workgroup_module",
+			.source = fmt::format(
+				"export static const uint HISTOGRAM_WORKGROUP_SIZE_X = {};"
+				"export static const bool LARGE_INDICES = {};"
+				"export static const uint ELEMENTS_PER_THREAD = {};",
+				size.x, large_indices, elements_per_thread
+			)
+		};
+
+		return shader_manager::program_compile_info {
+			.module_name = std::string(VKENGINE_SHADER_DIR) + "/histogram.slang",
+			.entry_points = {
+				shader_manager::entry_point_compile_info {
+					.name = "caculate_histogram",
+					.specialisation_type_names = { type_name<T>::value }
+				},
+				shader_manager::entry_point_compile_info {
+					.name = "caculate_histogram_view",
+					.specialisation_type_names = { type_name<T>::value }
+				}
+			},
+			.modules = { workgroup_module }
+		};
+	}
+
+	static std::vector<workgroup_size> tuning_candidates(const gpu& gpu) {
+		return workgroup_autotuner::candidates_1d(gpu);
+	}
+
+	template<uint32_t dims, access_policy policy>
+	void record(
+		vk::CommandBuffer cmd_buffer,
+		typed_buffer<T, dims, policy>& input,
+		typed_buffer<uint32_t, 1, policy>& output_histogram,
+		histogram_range range = default_histogram_range<T>()
+	) {
+		compute_recorder recorder(cmd_buffer);
+		record(recorder, input, output_histogram, range);
+	}
+
+	template<uint32_t dims, access_policy policy>
+	void record(
+		compute_recorder& recorder,
+		typed_buffer<T, dims, policy>& input,
+		typed_buffer<uint32_t, 1, policy>& output_histogram,
+		histogram_range range = default_histogram_range<T>()
+	) {
+		record_span(recorder, input.as_span(), output_histogram.as_span(), range);
+	}
+
+	// Counts the pixels of a region of interest in place
 	template<access_policy policy>
 	void record(
 		vk::CommandBuffer cmd_buffer,
-		typed_buffer<uint16_t, 2, policy>& input,
-		typed_buffer<uint32_t, 1, policy>& output_histogram
+		const strided_view<T, 2>& input,
+		typed_buffer<uint32_t, 1, policy>& output_histogram,
+		histogram_range range = default_histogram_range<T>()
 	) {
-		std::array<uint32_t, 3>	dispatch_counts = { (input.size() + workgroup_sizes[0] - 1) / workgroup_sizes[0], 1, 1 };
+		compute_recorder recorder(cmd_buffer);
+		record(recorder, input, output_histogram, range);
+	}
+
+	template<access_policy policy>
+	void record(
+		compute_recorder& recorder,
+		const strided_view<T, 2>& input,
+		typed_buffer<uint32_t, 1, policy>& output_histogram,
+		histogram_range range = default_histogram_range<T>()
+	) {
+		if (input.is_contiguous()) {
+			record_span(recorder, input.as_span(), output_histogram.as_span(), range);
+			return;
+		}
+
+		histogram_view_push_constants push_constants = {
+			.input = input,
+			.histogram = output_histogram.as_span(),
+			.range_min = range.min,
+			.bin_scale = float(output_histogram.size()) / (range.max - range.min)
+		};
+
+		const auto& histogram_shader_program = program(false, 1);
+
+		dispatch_shader(
+			recorder,
+			histogram_shader_program->entry_points[1],
+			group_counts_2d(input.shape(), workgroup_size_.x),
+			vk::ShaderStageFlagBits::eCompute,
+			push_constants
+		);
+	}
+private:
+	// The 1D kernel, for buffers and contiguous views
+	void record_span(compute_recorder& recorder, device_span input, device_span output_histogram, histogram_range range) {
+		uint32_t elements_per_thread = is_vector_aligned<T>(input.span) ? VECTOR_WIDTH : 1;
+		uint32_t group_count = group_count_1d((input.size + elements_per_thread - 1) / elements_per_thread, workgroup_size_.x);
+		bool large_indices = large_thread_indices(shader_manager_.gpu(), group_count, workgroup_size_.x);
 
 		histogram_push_constants histogram_push_constants = {
-			.input = input.device_span(),
-			.histogram = output_histogram.device_span()
+			.input = input,
+			.histogram = output_histogram,
+			.range_min = range.min,
+			.bin_scale = float(output_histogram.size) / (range.max - range.min)
 		};
 
+		const auto& histogram_shader_program = program(large_indices, elements_per_thread);
+
 		dispatch_shader(
-			cmd_buffer,
-			histogram_shader_program_.entry_points[0],
-			dispatch_counts,
+			recorder,
+			histogram_shader_program->entry_points[0],
+			{ group_count, 1, 1 },
 			vk::ShaderStageFlagBits::eCompute,
 			histogram_push_constants
 		);
 	}
-private:
-	static constexpr std::array<uint32_t, 3>	workgroup_sizes = { 512, 1, 1 };
-	shader_program								histogram_shader_program_;
+
+	// The view entry point is part of every variant
+	const shader_program_handle& program(bool large_indices, uint32_t elements_per_thread) {
+		return programs_.get({ large_indices, elements_per_thread }, [&] {
+			return program_info(workgroup_size_, large_indices, elements_per_thread);
+		});
+	}
+
+	shader_manager&	shader_manager_;
+	workgroup_size	workgroup_size_;
+	// By LARGE_INDICES and ELEMENTS_PER_THREAD
+	operator_programs<std::pair<bool, uint32_t>> programs_;
 };
 
-} // namespace vkengine
\ No newline at end of file
+} // namespace vkengine
@@ -2,12 +2,15 @@
 
 #include <algorithms/dispatch.hpp>
 #include <detailed_exception.hpp>
+#include <scratch_arena.hpp>
 #include <shader_manager.hpp>
 #include <typed_buffer.hpp>
+#include <workgroup_autotuner.hpp>
 
 namespace vkengine {
 
 constexpr uint32_t INCLUSIVE_SCAN_WORKGROUP_SIZE = 128;
+constexpr const char* INCLUSIVE_SCAN_TUNING_KEY = "inclusive_scan";
 
 struct inclusive_span_push_constants {
 	device_span input;
@@ -15,34 +18,26 @@ struct inclusive_span_push_constants {
 	device_span group_sums;
 };
 
-template<uint32_t dims, access_policy policy>
-void inclusive_scan(
-	typed_buffer<uint32_t, dims, policy>& input,
-	typed_buffer<uint32_t, dims, policy>& output,
-	typed_buffer<uint32_t, dims, policy>& group_sums,
-	shader_manager& shader_manager,
-	vk::CommandBuffer cmd_buffer
-) {
-	if (input.size() != output.size())
-		throw detailed_exception("Input and output buffers must be the same size");
-
-	std::array<uint32_t, 3> dispatch_counts = { 128, 1, 1 };
-	uint32_t group_count = (input.size() + dispatch_counts[0] - 1) / dispatch_counts[0];
-
-	if (group_sums.size() < group_count)
-		throw detailed_exception("Group sums buffer is too small");
+inline workgroup_size inclusive_scan_workgroup_size(shader_manager& shader_manager) {
+	return shader_manager.workgroup_sizes().get(INCLUSIVE_SCAN_TUNING_KEY, { .x = INCLUSIVE_SCAN_WORKGROUP_SIZE });
+}
 
-	auto workgroup_module = shader_manager.create_shader_module_from_source_string(
-		fmt::format(
-			"export static const uint INCLUSIVE_SCAN_WORKGROUP_SIZE = {};",
-			INCLUSIVE_SCAN_WORKGROUP_SIZE
-		),
-		"workgroup_module"
-	);
+inline shader_manager::program_compile_info inclusive_scan_program_info(
+	workgroup_size size = { .x = INCLUSIVE_SCAN_WORKGROUP_SIZE },
+	uint32_t elements_per_thread = 1
+) {
+	shader_manager::source_module workgroup_module = {
+		.name = "workgroup_module",
+		.source = fmt::format(
+			"export static const uint INCLUSIVE_SCAN_WORKGROUP_SIZE = {};"
+			"export static const uint ELEMENTS_PER_THREAD = {};",
+			size.x, elements_per_thread
+		)
+	};
 
-	auto shader_program = shader_manager.load_shader(
-		std::string(VKENGINE_SHADER_DIR) + "/inclusive_scan.slang",
-		{
+	return shader_manager::program_compile_info {
+		.module_name = std::string(VKENGINE_SHADER_DIR) + "/inclusive_scan.slang",
+		.entry_points = {
 			shader_manager::entry_point_compile_info {
 				.name = "workgroup_inclusive_scan",
 			},
@@ -53,18 +48,62 @@ void inclusive_scan(
 				.name = "propogate_group_sums",
 			}
 		},
-		{ workgroup_module }
-	);
+		.modules = { workgroup_module }
+	};
+}
+
+inline uint32_t inclusive_scan_elements_per_thread(vk::DeviceAddress input, vk::DeviceAddress output) {
+	return is_vector_aligned<uint32_t>(input) && is_vector_aligned<uint32_t>(output) ? VECTOR_WIDTH : 1;
+}
+
+// One group sum per workgroup, each covering elements_per_thread elements per thread
+inline uint32_t inclusive_scan_group_count(uint64_t element_count, workgroup_size size, uint32_t elements_per_thread) {
+	return group_count_1d((element_count + elements_per_thread - 1) / elements_per_thread, size.x);
+}
+
+// Every subgroup of a workgroup publishes its sum to one lane of the first subgroup, and the group sums are
+// scanned by a single subgroup, so candidates are multiples of the subgroup size up to its square
+inline std::vector<workgroup_size> inclusive_scan_tuning_candidates(const gpu& gpu) {
+	uint32_t subgroup_size = gpu.subgroup_properties.subgroupSize;
+	return workgroup_autotuner::candidates_1d(gpu, subgroup_size, subgroup_size * subgroup_size);
+}
+
+template<uint32_t dims, access_policy policy, device_buffer_view TGroupSums>
+void inclusive_scan(
+	typed_buffer<uint32_t, dims, policy>& input,
+	typed_buffer<uint32_t, dims, policy>& output,
+	TGroupSums& group_sums,
+	shader_manager& shader_manager,
+	compute_recorder& recorder,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	if (input.size() != output.size())
+		throw detailed_exception("Input and output buffers must be the same size");
+
+	auto scan_workgroup_size = size_override.value_or(inclusive_scan_workgroup_size(shader_manager));
+	uint32_t elements_per_thread = inclusive_scan_elements_per_thread(input.device_address(), output.device_address());
+	uint32_t group_count = inclusive_scan_group_count(input.size(), scan_workgroup_size, elements_per_thread);
+	std::array<uint32_t, 3> dispatch_counts = { group_count, 1, 1 };
+
+	if (group_sums.size() < group_count)
+		throw detailed_exception("Group sums buffer is too small");
+	// subgroup_exclusive_scan scans the group sums with a single subgroup
+	uint32_t subgroup_size = shader_manager.gpu().subgroup_properties.subgroupSize;
+	if (group_count > subgroup_size)
+		throw detailed_exception("Inclusive scan supports up to {} elements with workgroups of {}, got {}",
+			uint64_t(subgroup_size) * scan_workgroup_size.x * elements_per_thread, scan_workgroup_size.x, input.size());
+
+	auto shader_program = shader_manager.load_shader(inclusive_scan_program_info(scan_workgroup_size, elements_per_thread));
 
 	inclusive_span_push_constants scan_push_constants = {
 		.input = input,
 		.output = output,
-		.group_sums = group_sums
+		.group_sums = group_sums.as_span()
 	};
 
 	dispatch_shader(
-		cmd_buffer,
-		shader_program.entry_points[0],
+		recorder,
+		shader_program->entry_points[0],
 		dispatch_counts,
 		vk::ShaderStageFlagBits::eCompute,
 		scan_push_constants
@@ -78,14 +117,14 @@ void inclusive_scan(
 		.setBuffer(group_sums.vk_handle())
 		.setSize(VK_WHOLE_SIZE);
 
-	cmd_buffer.pipelineBarrier2(vk::DependencyInfo().setBufferMemoryBarriers(inclusive_scan_barrier));
+	recorder.pipeline_barrier(vk::DependencyInfo().setBufferMemoryBarriers(inclusive_scan_barrier));
 
 	dispatch_shader<device_span>(
-		cmd_buffer,
-		shader_program.entry_points[1],
+		recorder,
+		shader_program->entry_points[1],
 		{1, 1, 1},
 		vk::ShaderStageFlagBits::eCompute,
-		group_sums
+		group_sums.as_span()
 	);
 
 	{
@@ -107,16 +146,59 @@ void inclusive_scan(
 				.setSize(VK_WHOLE_SIZE)
 		};
 
-		cmd_buffer.pipelineBarrier2(vk::DependencyInfo().setBufferMemoryBarriers(barriers));
+		recorder.pipeline_barrier(vk::DependencyInfo().setBufferMemoryBarriers(barriers));
 	}
 
 	dispatch_shader(
-		cmd_buffer,
-		shader_program.entry_points[2],
+		recorder,
+		shader_program->entry_points[2],
 		{group_count, 1, 1},
 		vk::ShaderStageFlagBits::eCompute,
 		scan_push_constants
 	);
 }
 
+template<uint32_t dims, access_policy policy, device_buffer_view TGroupSums>
+void inclusive_scan(
+	typed_buffer<uint32_t, dims, policy>& input,
+	typed_buffer<uint32_t, dims, policy>& output,
+	TGroupSums& group_sums,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	compute_recorder recorder(cmd_buffer);
+	inclusive_scan(input, output, group_sums, shader_manager, recorder, size_override);
+}
+
+// Takes the group sums from the scratch arena, so they live until the arena retires the current frame
+template<uint32_t dims, access_policy policy>
+void inclusive_scan(
+	typed_buffer<uint32_t, dims, policy>& input,
+	typed_buffer<uint32_t, dims, policy>& output,
+	scratch_arena& scratch,
+	shader_manager& shader_manager,
+	compute_recorder& recorder,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	auto scan_workgroup_size = size_override.value_or(inclusive_scan_workgroup_size(shader_manager));
+	auto group_sums = scratch.allocate<uint32_t>(inclusive_scan_group_count(
+		input.size(), scan_workgroup_size, inclusive_scan_elements_per_thread(input.device_address(), output.device_address())));
+
+	inclusive_scan(input, output, group_sums, shader_manager, recorder, scan_workgroup_size);
+}
+
+template<uint32_t dims, access_policy policy>
+void inclusive_scan(
+	typed_buffer<uint32_t, dims, policy>& input,
+	typed_buffer<uint32_t, dims, policy>& output,
+	scratch_arena& scratch,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	compute_recorder recorder(cmd_buffer);
+	inclusive_scan(input, output, scratch, shader_manager, recorder, size_override);
+}
+
 } // namespace vkengine
\ No newline at end of file
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <algorithms/dispatch.hpp>
+#include <algorithms/types.hpp>
 #include <detailed_exception.hpp>
 #include <shader_manager.hpp>
 #include <typed_buffer.hpp>
+#include <workgroup_autotuner.hpp>
 
 namespace vkengine {
 
@@ -15,61 +17,136 @@ struct median_filter_push_constants {
 	device_mdspan<2> output;
 };
 
+// The entry point has to be specialised for the layouts of input and output
+inline void record_median_filter(
+	const device_mdspan<2>&				input,
+	const device_mdspan<2>&				output,
+	const shader_entry_point&			median_filter_entry_point,
+	workgroup_size						size,
+	compute_recorder&					recorder
+) {
+	median_filter_push_constants push_constants = {
+		.input = input,
+		.output = output
+	};
+
+	dispatch_shader(
+		recorder,
+		median_filter_entry_point,
+		group_counts_2d(input.dims, size.x, size.y),
+		vk::ShaderStageFlagBits::eCompute,
+		push_constants
+	);
+}
+
+template<pixel_type T = uint16_t>
 class median_filter_operator {
 public:
-	median_filter_operator(shader_manager& shader_manager) {
-		auto workgroup_module = shader_manager.create_shader_module_from_source_string(
-			fmt::format(
+	static constexpr const char* TUNING_KEY = "median_filter";
+	static constexpr workgroup_size DEFAULT_WORKGROUP_SIZE = { .x = MEDIAN_FILTER_WORKGROUP_SIZE_X, .y = MEDIAN_FILTER_WORKGROUP_SIZE_Y };
+
+	// With the tuned workgroup size when there is one
+	median_filter_operator(shader_manager& shader_manager)
+		: median_filter_operator(shader_manager, shader_manager.workgroup_sizes().get(TUNING_KEY, DEFAULT_WORKGROUP_SIZE)) {}
+
+	median_filter_operator(shader_manager& shader_manager, workgroup_size size)
+		: shader_manager_(shader_manager), workgroup_size_(size), programs_(shader_manager) {
+		require_pixel_type<T>(shader_manager_.gpu());
+		program(buffer_layout::linear, buffer_layout::linear);
+	}
+
+	static shader_manager::program_compile_info program_info(
+		workgroup_size size = DEFAULT_WORKGROUP_SIZE,
+		buffer_layout input_layout = buffer_layout::linear,
+		buffer_layout output_layout = buffer_layout::linear
+	) {
+		shader_manager::source_module workgroup_module = {
+			.name = "workgroup_module",
+			.source = fmt::format(
 				"export static const uint MEDIAN_FILTER_WORKGROUP_SIZE_X = {};"
 				"export static const uint MEDIAN_FILTER_WORKGROUP_SIZE_Y = {};",
-				MEDIAN_FILTER_WORKGROUP_SIZE_X, MEDIAN_FILTER_WORKGROUP_SIZE_Y
-			), "workgroup_module" );
-
-		median_filter_entry_point_ = shader_manager.load_shader(
-			"median_filter",
-			{ shader_manager::entry_point_compile_info { .name = "median_filter" } },
-			{ workgroup_module }
-		).entry_points[0];
+				size.x, size.y
+			)
+		};
+
+		return shader_manager::program_compile_info {
+			.module_name = "median_filter",
+			.entry_points = {
+				shader_manager::entry_point_compile_info {
+					.name = "median_filter",
+					.specialisation_type_names = { type_name<T>::value, layout_type_name(input_layout), layout_type_name(output_layout) }
+				}
+			},
+			.modules = { workgroup_module }
+		};
 	}
 
-	template<access_policy policy>
+	// The shared tile, including its halo, has to fit into shared memory. It holds every pixel type as 32 bits.
+	static std::vector<workgroup_size> tuning_candidates(const gpu& gpu) {
+		auto candidates = workgroup_autotuner::candidates_2d(gpu);
+		std::erase_if(candidates, [&](workgroup_size size) {
+			return (size.x + 2) * (size.y + 2) * sizeof(uint32_t) > gpu.properties.properties.limits.maxComputeSharedMemorySize;
+		});
+		return candidates;
+	}
+
+	// Either buffer can be tiled, which keeps the 3x3 neighbourhoods in fewer cache lines on large frames
+	template<access_policy policy, buffer_layout input_layout, buffer_layout output_layout>
 	void record(
-		typed_buffer<uint16_t, 2, policy>&	input,
-		typed_buffer<uint16_t, 2, policy>&	output,
-		vk::CommandBuffer					cmd_buffer
+		typed_buffer<T, 2, policy, buffer_kind::storage, input_layout>&		input,
+		typed_buffer<T, 2, policy, buffer_kind::storage, output_layout>&	output,
+		vk::CommandBuffer													cmd_buffer
 	) {
-		record_median_filter(input, output, median_filter_entry_point_, cmd_buffer);
+		compute_recorder recorder(cmd_buffer);
+		record(input, output, recorder);
 	}
 
-private:
-	shader_entry_point median_filter_entry_point_;
-};
+	template<access_policy policy, buffer_layout input_layout, buffer_layout output_layout>
+	void record(
+		typed_buffer<T, 2, policy, buffer_kind::storage, input_layout>&		input,
+		typed_buffer<T, 2, policy, buffer_kind::storage, output_layout>&	output,
+		compute_recorder&													recorder
+	) {
+		if (input.shape() != output.shape())
+			throw detailed_exception("Input and output must have the same shape");
 
-template<access_policy policy>
-void record_median_filter(
-	typed_buffer<uint16_t, 2, policy>&	input,
-	typed_buffer<uint16_t, 2, policy>&	output,
-	shader_entry_point&					median_filter_entry_point,
-	vk::CommandBuffer					cmd_buffer
-) {
-	median_filter_push_constants push_constants = {
-		.input = input,
-		.output = output
-	};
+		const auto& median_filter_program = program(input_layout, output_layout);
+		record_median_filter(input.as_mdspan(), output.as_mdspan(), median_filter_program->entry_points[0], workgroup_size_, recorder);
+	}
 
-	std::array<uint32_t, 3> workgroup_counts = { 
-		(input.shape()[1] + MEDIAN_FILTER_WORKGROUP_SIZE_X - 1) / MEDIAN_FILTER_WORKGROUP_SIZE_X,
-		(input.shape()[0] + MEDIAN_FILTER_WORKGROUP_SIZE_Y - 1) / MEDIAN_FILTER_WORKGROUP_SIZE_Y,
-		1 
-	};
+	// Filters a region of interest in place, its borders are clamped to the region like the borders of a frame
+	void record(
+		const strided_view<T, 2>&	input,
+		const strided_view<T, 2>&	output,
+		vk::CommandBuffer			cmd_buffer
+	) {
+		compute_recorder recorder(cmd_buffer);
+		record(input, output, recorder);
+	}
 
-	dispatch_shader(
-		cmd_buffer,
-		median_filter_entry_point,
-		workgroup_counts,
-		vk::ShaderStageFlagBits::eCompute,
-		push_constants
-	);
-}
+	void record(
+		const strided_view<T, 2>&	input,
+		const strided_view<T, 2>&	output,
+		compute_recorder&			recorder
+	) {
+		if (input.shape() != output.shape())
+			throw detailed_exception("Input and output must have the same shape");
+
+		const auto& median_filter_program = program(buffer_layout::linear, buffer_layout::linear);
+		record_median_filter(input.as_mdspan(), output.as_mdspan(), median_filter_program->entry_points[0], workgroup_size_, recorder);
+	}
+
+private:
+	const shader_program_handle& program(buffer_layout input_layout, buffer_layout output_layout) {
+		return programs_.get({ input_layout, output_layout }, [&] {
+			return program_info(workgroup_size_, input_layout, output_layout);
+		});
+	}
+
+	shader_manager&	shader_manager_;
+	workgroup_size	workgroup_size_;
+	// By input and output layout
+	operator_programs<std::pair<buffer_layout, buffer_layout>> programs_;
+};
 
 }
\ No newline at end of file
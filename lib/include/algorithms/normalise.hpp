@@ -2,12 +2,14 @@
 
 #include <algorithms/dispatch.hpp>
 #include <algorithms/types.hpp>
+#include <workgroup_autotuner.hpp>
 
 namespace vkengine {
 
 constexpr uint32_t NORMALISE_WORKGROUP_SIZE_X = 128;
+constexpr const char* NORMALISE_TUNING_KEY = "normalise";
 
-template<typename T, typename U>
+template<pixel_type T, pixel_type U>
 struct normalise_push_constants {
 	device_span input;
 	device_span output;
@@ -17,7 +19,98 @@ struct normalise_push_constants {
 	U max;
 };
 
-template<typename T, typename U, uint32_t dims, access_policy policy>
+template<pixel_type T, pixel_type U>
+struct normalise_view_push_constants {
+	device_mdspan<2> input;
+	device_mdspan<2> output;
+	T input_min;
+	T input_max;
+	U min;
+	U max;
+};
+
+inline workgroup_size normalise_workgroup_size(shader_manager& shader_manager) {
+	return shader_manager.workgroup_sizes().get(NORMALISE_TUNING_KEY, { .x = NORMALISE_WORKGROUP_SIZE_X });
+}
+
+// Converts from T to U in the same pass, e.g. uint16_t raw frames straight to float or uint8_t previews
+template<pixel_type T, pixel_type U>
+shader_manager::program_compile_info normalise_program_info(
+	workgroup_size size = { .x = NORMALISE_WORKGROUP_SIZE_X },
+	bool large_indices = false,
+	uint32_t elements_per_thread = 1
+) {
+	shader_manager::source_module workgroup_module = {
+		.name = "workgroup_module",
+		.source = fmt::format(
+			"export static const uint NORMALISE_WORKGROUP_SIZE_X = {};"
+			"export static const bool LARGE_INDICES = {};"
+			"export static const uint ELEMENTS_PER_THREAD = {};",
+			size.x, large_indices, elements_per_thread
+		)
+	};
+
+	return shader_manager::program_compile_info {
+		.module_name = std::string(VKENGINE_SHADER_DIR) + "/normalise.slang",
+		.entry_points = {
+			shader_manager::entry_point_compile_info {
+				.name = "normalise",
+				.specialisation_type_names = { type_name<T>::value, type_name<U>::value }
+			},
+			shader_manager::entry_point_compile_info {
+				.name = "normalise_view",
+				.specialisation_type_names = { type_name<T>::value, type_name<U>::value }
+			}
+		},
+		.modules = { workgroup_module }
+	};
+}
+
+inline std::vector<workgroup_size> normalise_tuning_candidates(const gpu& gpu) {
+	return workgroup_autotuner::candidates_1d(gpu);
+}
+
+// The 1D kernel over spans of the same size, for buffers and contiguous views
+template<pixel_type T, pixel_type U>
+void record_normalise(
+	device_span input,
+	device_span output,
+	T input_min,
+	T input_max,
+	U min,
+	U max,
+	shader_manager& shader_manager,
+	compute_recorder& recorder,
+	std::optional<workgroup_size> size_override
+) {
+	auto normalise_workgroup = size_override.value_or(normalise_workgroup_size(shader_manager));
+	uint32_t elements_per_thread =
+		is_vector_aligned<T>(input.span) && is_vector_aligned<U>(output.span) ? VECTOR_WIDTH : 1;
+	uint32_t group_count = group_count_1d((input.size + elements_per_thread - 1) / elements_per_thread, normalise_workgroup.x);
+	bool large_indices = large_thread_indices(shader_manager.gpu(), group_count, normalise_workgroup.x);
+
+	auto shader_program = shader_manager.load_shader(
+		normalise_program_info<T, U>(normalise_workgroup, large_indices, elements_per_thread));
+
+	normalise_push_constants<T, U> push_constants = {
+		.input = input,
+		.output = output,
+		.input_min = input_min,
+		.input_max = input_max,
+		.min = min,
+		.max = max
+	};
+
+	dispatch_shader(
+		recorder,
+		shader_program->entry_points[0],
+		{ group_count, 1, 1 },
+		vk::ShaderStageFlagBits::eCompute,
+		push_constants
+	);
+}
+
+template<pixel_type T, pixel_type U, uint32_t dims, access_policy policy>
 void normalise(
 	typed_buffer<T, dims, policy>& input,
 	typed_buffer<U, dims, policy>& output,
@@ -26,30 +119,60 @@ void normalise(
 	U min,
 	U max,
 	shader_manager& shader_manager,
-	vk::CommandBuffer cmd_buffer
+	compute_recorder& recorder,
+	std::optional<workgroup_size> size_override = std::nullopt
 ) {
 	if (input.size() != output.size())
 		throw detailed_exception("Input and output buffers must be the same size");
+	require_pixel_type<T>(shader_manager.gpu());
+	require_pixel_type<U>(shader_manager.gpu());
 
-	auto workgroup_module = shader_manager.create_shader_module_from_source_string(
-		fmt::format(
-			"export static const uint NORMALISE_WORKGROUP_SIZE_X = {};",
-			NORMALISE_WORKGROUP_SIZE_X
-		),
-		"workgroup_module"
-	);
+	record_normalise(input.as_span(), output.as_span(), input_min, input_max, min, max, shader_manager, recorder, size_override);
+}
 
-	shader_manager::entry_point_compile_info entry_point_compile_info = {
-		.name = "normalise",
-	};
+template<pixel_type T, pixel_type U, uint32_t dims, access_policy policy>
+void normalise(
+	typed_buffer<T, dims, policy>& input,
+	typed_buffer<U, dims, policy>& output,
+	T input_min,
+	T input_max,
+	U min,
+	U max,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	compute_recorder recorder(cmd_buffer);
+	normalise(input, output, input_min, input_max, min, max, shader_manager, recorder, size_override);
+}
 
-	auto shader_program = shader_manager.load_shader(
-		std::string(VKENGINE_SHADER_DIR) + "/normalise.slang",
-		{ entry_point_compile_info },
-		{ workgroup_module }
-	);
+// Normalises a region of interest in place, input and output views may be regions of the same buffer
+template<pixel_type T, pixel_type U>
+void normalise(
+	const strided_view<T, 2>& input,
+	const strided_view<U, 2>& output,
+	T input_min,
+	T input_max,
+	U min,
+	U max,
+	shader_manager& shader_manager,
+	compute_recorder& recorder,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	if (input.shape() != output.shape())
+		throw detailed_exception("Input and output views must have the same shape");
+	require_pixel_type<T>(shader_manager.gpu());
+	require_pixel_type<U>(shader_manager.gpu());
 
-	normalise_push_constants<T, U> push_constants = {
+	if (input.is_contiguous() && output.is_contiguous()) {
+		record_normalise(input.as_span(), output.as_span(), input_min, input_max, min, max, shader_manager, recorder, size_override);
+		return;
+	}
+
+	auto normalise_workgroup = size_override.value_or(normalise_workgroup_size(shader_manager));
+	auto shader_program = shader_manager.load_shader(normalise_program_info<T, U>(normalise_workgroup));
+
+	normalise_view_push_constants<T, U> push_constants = {
 		.input = input,
 		.output = output,
 		.input_min = input_min,
@@ -58,15 +181,29 @@ void normalise(
 		.max = max
 	};
 
-	std::array<uint32_t, 3> workgroup_counts = { (input.size() + NORMALISE_WORKGROUP_SIZE_X - 1) / NORMALISE_WORKGROUP_SIZE_X, 1, 1 };
-
 	dispatch_shader(
-		cmd_buffer,
-		shader_program.entry_points[0],
-		workgroup_counts,
+		recorder,
+		shader_program->entry_points[1],
+		group_counts_2d(input.shape(), normalise_workgroup.x),
 		vk::ShaderStageFlagBits::eCompute,
 		push_constants
 	);
 }
 
+template<pixel_type T, pixel_type U>
+void normalise(
+	const strided_view<T, 2>& input,
+	const strided_view<U, 2>& output,
+	T input_min,
+	T input_max,
+	U min,
+	U max,
+	shader_manager& shader_manager,
+	vk::CommandBuffer cmd_buffer,
+	std::optional<workgroup_size> size_override = std::nullopt
+) {
+	compute_recorder recorder(cmd_buffer);
+	normalise(input, output, input_min, input_max, min, max, shader_manager, recorder, size_override);
+}
+
 }
\ No newline at end of file
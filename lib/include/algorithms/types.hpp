@@ -1,19 +1,79 @@
 #pragma once
 
+#include <detailed_exception.hpp>
+#include <gpu.hpp>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
 namespace vkengine {
 
+// Storage for a 16-bit IEEE float pixel. The host only ever moves these around, the shaders do the arithmetic.
+struct float16 {
+    uint16_t bits;
+};
+
 // Primary template (undefined to prevent implicit instantiation)
 template<typename T>
 struct type_name;
 
+template<>
+struct type_name<uint8_t> {
+    static constexpr const char* value = "uint8_t";
+};
+
 template<>
 struct type_name<uint16_t> {
     static constexpr const char* value = "uint16_t";
 };
 
+template<>
+struct type_name<int16_t> {
+    static constexpr const char* value = "int16_t";
+};
+
 template<>
 struct type_name<uint32_t> {
     static constexpr const char* value = "uint32_t";
 };
 
-}
\ No newline at end of file
+template<>
+struct type_name<int32_t> {
+    static constexpr const char* value = "int32_t";
+};
+
+template<>
+struct type_name<float16> {
+    static constexpr const char* value = "half";
+};
+
+template<>
+struct type_name<float> {
+    static constexpr const char* value = "float";
+};
+
+// Types the generic kernels can be specialised for, see shaders/pixel.slang
+template<typename T>
+concept pixel_type = requires { type_name<T>::value; };
+
+// 8-bit and half pixels need optional device features, which vulkan_core only enables when the device has them
+template<pixel_type T>
+bool pixel_type_supported(const gpu& gpu) {
+    if constexpr (sizeof(T) == 1) {
+        return gpu.shader_float16_int8_features.shaderInt8
+            && gpu.storage_8bit_features.storageBuffer8BitAccess
+            && gpu.storage_8bit_features.storagePushConstant8;
+    } else if constexpr (std::is_same_v<T, float16>) {
+        return gpu.shader_float16_int8_features.shaderFloat16;
+    } else {
+        return true;
+    }
+}
+
+template<pixel_type T>
+void require_pixel_type(const gpu& gpu) {
+    if (!pixel_type_supported<T>(gpu))
+        throw detailed_exception("{} does not support {} pixels", gpu.properties.properties.deviceName.data(), type_name<T>::value);
+}
+
+}
@@ -2,9 +2,17 @@
 
 #include <vulkan_core.hpp>
 #include <vma/vk_mem_alloc.h>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace vkengine {
 
+class deletion_queue;
+
 struct image {
     vk::Image handle;
     vk::Extent3D extent;
@@ -18,10 +26,81 @@ struct buffer {
     vk::DeviceSize size;
     VmaAllocation allocation;
     VmaAllocationInfo allocation_info;
+    // Set for buffers wrapping imported host memory, which VMA does not know about
+    vk::DeviceMemory imported_memory;
+    // Set for buffers past maxMemoryAllocationSize, sparse bound to several allocations behind one address
+    std::vector<VmaAllocation> chunks;
+};
+
+// Tags allocations made on this thread while it is alive, e.g. with the operator or buffer role they are for.
+// Tags nest, the innermost one wins. Untagged allocations are reported as "untagged".
+class allocation_tag {
+public:
+    explicit allocation_tag(std::string tag);
+    ~allocation_tag();
+
+    allocation_tag(const allocation_tag&) = delete;
+    allocation_tag& operator=(const allocation_tag&) = delete;
+};
+
+struct tag_statistics {
+    vk::DeviceSize  bytes = 0;
+    vk::DeviceSize  peak_bytes = 0;
+    uint32_t        allocations = 0;
+};
+
+struct heap_budget {
+    uint32_t        heap_index;
+    bool            device_local;
+    // Usage and budget of the whole process, from VK_EXT_memory_budget when it is enabled
+    vk::DeviceSize  usage;
+    vk::DeviceSize  budget;
+    vk::DeviceSize  peak_usage;
+    // What this allocator has allocated from the heap
+    vk::DeviceSize  allocated_bytes;
 };
 
 class allocator {
+public:
+    // Called on the allocating thread when an allocation brings a heap's usage to the threshold fraction of its
+    // budget. It fires again only after usage has dropped below the threshold in between.
+    using budget_callback = std::function<void(const heap_budget& heap)>;
+private:
+    struct tracked_allocation {
+        std::string     tag;
+        vk::DeviceSize  size;
+    };
+
+    void track(VmaAllocation allocation, const VmaAllocationInfo& allocation_info) const;
+    void untrack(VmaAllocation allocation) const;
+    void check_budget(uint32_t memory_type) const;
+
     VmaAllocator allocator_;
+    std::reference_wrapper<const vulkan_core> core_;
+    vk::Device device_;
+    vk::PhysicalDeviceMemoryProperties memory_properties_;
+    vk::DeviceSize host_import_alignment_ = 0;
+    vk::DeviceSize max_allocation_size_;
+    vk::DeviceSize max_buffer_size_;
+    // The compute queue when it can bind sparse memory, locked through vulkan_core::lock_compute_queue
+    vk::Queue sparse_queue_;
+
+    mutable std::mutex telemetry_mutex_;
+    mutable std::unordered_map<VmaAllocation, tracked_allocation> allocations_;
+    mutable std::unordered_map<std::string, tag_statistics> tag_statistics_;
+    mutable std::vector<vk::DeviceSize> peak_heap_usage_;
+    mutable std::vector<bool> over_budget_;
+    budget_callback on_budget_;
+    float budget_threshold_ = 1.0f;
+
+    // Held while a buffer is handed to the queue, so that the queue can not be detached and destroyed meanwhile
+    mutable std::mutex deletion_queue_mutex_;
+    deletion_queue* deletion_queue_ = nullptr;
+
+    buffer create_chunked_buffer(
+        const vk::BufferCreateInfo& buffer_info,
+        const VmaAllocationCreateInfo& allocation_create_info
+    ) const;
 public:
     allocator(const vulkan_core& core);
     ~allocator();
@@ -37,11 +116,42 @@ public:
     ) const;
     void destroy_image(image& image) const;
 
+    // Buffers past maxMemoryAllocationSize are chunked when the device supports sparse binding, they can not
+    // be host mapped
     buffer create_buffer(
         const vk::BufferCreateInfo& buffer_info,
         const VmaAllocationCreateInfo& allocation_create_info
     ) const;
     void destroy_buffer(buffer& buffer) const;
+    // For buffers dropped while the device may still use them. They go to the deletion queue when there is one,
+    // otherwise they are destroyed right away.
+    void retire_buffer(buffer buffer) const;
+    void set_deletion_queue(deletion_queue* queue);
+
+    // Wraps existing host memory through VK_EXT_external_memory_host, without a copy. Returns nullopt and logs why
+    // when the extension is not enabled or the pointer or size is not a multiple of host_import_alignment().
+    // The memory has to outlive the buffer.
+    std::optional<buffer> import_host_buffer(const vk::BufferCreateInfo& buffer_info, void* host_pointer) const;
+    // minImportedHostPointerAlignment, 0 when host memory cannot be imported
+    vk::DeviceSize host_import_alignment() const;
+
+    // Makes host writes to mapped memory visible to the device, a no-op for host coherent memory
+    void flush_buffer(const buffer& buffer, vk::DeviceSize offset, vk::DeviceSize size) const;
+    // Makes device writes visible to host reads of mapped memory, a no-op for host coherent memory
+    void invalidate_buffer(const buffer& buffer, vk::DeviceSize offset, vk::DeviceSize size) const;
+
+    [[nodiscard]]
+    std::unordered_map<std::string, tag_statistics> statistics_by_tag() const;
+    [[nodiscard]]
+    std::vector<heap_budget> heap_budgets() const;
+    // Budget left in device local heaps, for operators deciding how much of a batch fits before spilling
+    [[nodiscard]]
+    vk::DeviceSize available_device_memory() const;
+    // vmaBuildStatsString, allocation names are the tags
+    [[nodiscard]]
+    std::string statistics_json(bool detailed = false) const;
+
+    void set_budget_callback(budget_callback callback, float threshold = 1.0f);
 };
 
 }
\ No newline at end of file
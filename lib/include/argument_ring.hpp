@@ -0,0 +1,77 @@
+#pragma once
+
+#include <allocator.hpp>
+#include <typed_buffer.hpp>
+#include <vulkan_core.hpp>
+
+#include <cstring>
+#include <deque>
+#include <span>
+#include <type_traits>
+
+namespace vkengine {
+
+// Host visible ring buffer for kernel arguments that do not fit into push constants, e.g. the spans of every
+// frame of an N-frame average. Arguments are written linearly and passed to the kernel as a device_span in its
+// push constants. Space is recycled once the timeline semaphore reaches the value given to retire() for the
+// submission that used it. Not thread safe, use one ring per recording thread.
+class argument_ring {
+public:
+    static constexpr vk::DeviceSize DEFAULT_CAPACITY = 1 << 20;
+    static constexpr vk::DeviceSize ALIGNMENT = 16;
+
+    argument_ring(
+        std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        vk::Semaphore timeline_semaphore,
+        vk::DeviceSize capacity = DEFAULT_CAPACITY
+    );
+    ~argument_ring();
+
+    argument_ring(const argument_ring&) = delete;
+    argument_ring& operator=(const argument_ring&) = delete;
+
+    template<typename T>
+    device_span write(std::span<const T> arguments) {
+        static_assert(std::is_trivially_copyable_v<T>, "Arguments must be trivially copyable.");
+
+        auto address = write_bytes(std::as_bytes(arguments), alignof(T));
+        return { address, arguments.size() };
+    }
+
+    template<typename T>
+    device_span write(const T& arguments) {
+        return write(std::span<const T>(&arguments, 1));
+    }
+
+    // Everything written since the last retire() is in use until the timeline semaphore reaches timeline_value.
+    // Call once per submission, before writing arguments for the next one.
+    void retire(uint64_t timeline_value);
+
+    [[nodiscard]]
+    vk::DeviceSize capacity() const noexcept;
+    // Bytes written and not yet reclaimed, including padding
+    [[nodiscard]]
+    vk::DeviceSize in_use() const noexcept;
+private:
+    struct retired_region {
+        vk::DeviceSize  end;
+        uint64_t        timeline_value;
+    };
+
+    vk::DeviceAddress write_bytes(std::span<const std::byte> bytes, vk::DeviceSize alignment);
+    void reclaim(bool wait);
+
+    std::reference_wrapper<allocator>   allocator_;
+    vk::Device                          device_;
+    vk::Semaphore                       timeline_semaphore_;
+    buffer                              buffer_;
+    vk::DeviceAddress                   address_;
+
+    // Offsets grow monotonically, the position in the buffer is offset % capacity
+    vk::DeviceSize                      head_ = 0;
+    vk::DeviceSize                      tail_ = 0;
+    std::deque<retired_region>          retired_;
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <shader_manager.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstddef>
+#include <span>
+
+namespace vkengine {
+
+// Records compute work into a command buffer while shadowing the state it sets, so that re-binding the bound
+// shader object or re-pushing unchanged push constants emits nothing, and changed push constants only emit the
+// bytes that differ. This matters for many small dispatches of the same shader, e.g. per-tile work.
+// Commands recorded on command_buffer() directly bypass the shadow state, call invalidate() afterwards.
+class compute_recorder {
+public:
+    static constexpr uint32_t PUSH_CONSTANT_CAPACITY = 128;
+
+    struct statistics {
+        uint64_t dispatches = 0;
+        uint64_t indirect_dispatches = 0;
+        uint64_t shader_binds = 0;
+        uint64_t shader_binds_elided = 0;
+        uint64_t push_constant_updates = 0;
+        uint64_t push_constant_updates_elided = 0;
+        uint64_t push_constant_bytes = 0;
+        uint64_t barriers = 0;
+    };
+
+    explicit compute_recorder(vk::CommandBuffer cmd_buffer);
+
+    [[nodiscard]]
+    vk::CommandBuffer command_buffer() const noexcept;
+
+    void bind_shader(const shader_entry_point& shader, vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eCompute);
+    void push_constants(const shader_entry_point& shader, std::span<const std::byte> bytes);
+
+    void dispatch(const std::array<uint32_t, 3>& group_counts);
+    void dispatch_indirect(vk::Buffer buffer, vk::DeviceSize offset);
+    void pipeline_barrier(const vk::DependencyInfo& dependency_info);
+
+    // Forgets the shadowed state, the next bind and push are recorded in full
+    void invalidate() noexcept;
+
+    [[nodiscard]]
+    const statistics& stats() const noexcept;
+private:
+    vk::CommandBuffer       cmd_buffer_;
+
+    vk::ShaderEXT           bound_shader_;
+    vk::ShaderStageFlagBits bound_stage_ = vk::ShaderStageFlagBits::eCompute;
+
+    // Push constants stay valid across binds while the layouts agree on the push constant range
+    vk::PushConstantRange   push_constant_range_;
+    bool                    push_constants_valid_ = false;
+    std::array<std::byte, PUSH_CONSTANT_CAPACITY> push_constant_bytes_ {};
+
+    statistics              stats_;
+};
+
+}
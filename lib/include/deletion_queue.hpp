@@ -0,0 +1,59 @@
+#pragma once
+
+#include <allocator.hpp>
+#include <vulkan_core.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace vkengine {
+
+// Frees buffers once the device is done with them, instead of waiting for the device to idle. While it exists,
+// typed_buffers of its allocator that go out of scope are retired here and freed on a background thread once
+// the timeline semaphore reaches the last value passed to submitted().
+//
+// Call submitted() with the signal value of every submission before dropping the buffers it uses.
+class deletion_queue {
+public:
+    deletion_queue(
+        std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        vk::Semaphore timeline_semaphore
+    );
+    // Waits for every retired buffer's timeline value and frees it
+    ~deletion_queue();
+
+    deletion_queue(const deletion_queue&) = delete;
+    deletion_queue& operator=(const deletion_queue&) = delete;
+
+    // Work up to timeline_value has been submitted
+    void submitted(uint64_t timeline_value);
+
+    void retire(buffer buffer);
+
+    // Buffers retired and not yet freed
+    [[nodiscard]]
+    size_t pending() const;
+private:
+    struct retired_buffer {
+        buffer      buffer;
+        uint64_t    timeline_value;
+    };
+
+    void free_retired(std::stop_token stop);
+
+    std::reference_wrapper<allocator>   allocator_;
+    vk::Device                          device_;
+    vk::Semaphore                       timeline_semaphore_;
+
+    mutable std::mutex                  mutex_;
+    std::condition_variable_any         retired_cv_;
+    std::deque<retired_buffer>          retired_;
+    uint64_t                            timeline_value_ = 0;
+
+    std::jthread                        deletion_thread_;
+};
+
+}
@@ -10,21 +10,41 @@ struct gpu {
     vk::PhysicalDevice                      physical_device;
     vk::PhysicalDeviceProperties2           properties;
     vk::PhysicalDeviceFeatures2             features;
+    // Optional, vulkan_core enables what is reported here. See pixel_type_supported.
+    vk::PhysicalDeviceShaderFloat16Int8Features shader_float16_int8_features;
+    vk::PhysicalDevice8BitStorageFeatures   storage_8bit_features;
     vk::PhysicalDeviceMemoryProperties2     memory_properties;
     std::vector<vk::QueueFamilyProperties>  queue_family_properties;
     vk::PhysicalDeviceSubgroupProperties    subgroup_properties;
+    vk::PhysicalDeviceIDProperties          id_properties;
+    vk::PhysicalDeviceShaderObjectPropertiesEXT shader_object_properties;
+    vk::PhysicalDeviceExternalMemoryHostPropertiesEXT external_memory_host_properties;
 };
 
 [[nodiscard]] inline std::vector<gpu> enumerate_gpus(vk::Instance instance) {
     return instance.enumeratePhysicalDevices() | std::views::transform([](vk::PhysicalDevice phys_dev) {
-        auto properties = phys_dev.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+        auto properties = phys_dev.getProperties2<
+            vk::PhysicalDeviceProperties2,
+            vk::PhysicalDeviceSubgroupProperties,
+            vk::PhysicalDeviceIDProperties,
+            vk::PhysicalDeviceShaderObjectPropertiesEXT,
+            vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
 
         gpu g;
 
         g.physical_device = phys_dev;
 		g.properties = properties.get<vk::PhysicalDeviceProperties2>();
 		g.subgroup_properties = properties.get<vk::PhysicalDeviceSubgroupProperties>();
-        g.features = phys_dev.getFeatures2();
+		g.id_properties = properties.get<vk::PhysicalDeviceIDProperties>();
+		g.shader_object_properties = properties.get<vk::PhysicalDeviceShaderObjectPropertiesEXT>();
+		g.external_memory_host_properties = properties.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
+        auto features = phys_dev.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceShaderFloat16Int8Features,
+            vk::PhysicalDevice8BitStorageFeatures>();
+        g.features = features.get<vk::PhysicalDeviceFeatures2>();
+        g.shader_float16_int8_features = features.get<vk::PhysicalDeviceShaderFloat16Int8Features>();
+        g.storage_8bit_features = features.get<vk::PhysicalDevice8BitStorageFeatures>();
         g.memory_properties = phys_dev.getMemoryProperties2();
         g.queue_family_properties = phys_dev.getQueueFamilyProperties();
 
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vkengine {
+
+// Reference counted store of push descriptor set layouts and pipeline layouts, one per shader_manager.
+// Identical binding lists and push constant ranges map to the same handle within it, so programs
+// with matching interfaces share a pipeline layout and stay compatible for push descriptors and
+// push constants across bindShadersEXT switches. Every acquire must be paired with a release,
+// the object is destroyed when its last reference is released.
+class layout_cache {
+public:
+    struct statistics {
+        size_t   descriptor_set_layouts = 0;
+        size_t   pipeline_layouts = 0;
+        uint64_t descriptor_set_layout_reuses = 0;
+        uint64_t pipeline_layout_reuses = 0;
+    };
+
+    explicit layout_cache(vk::Device device);
+    ~layout_cache();
+
+    layout_cache(const layout_cache&) = delete;
+    layout_cache& operator=(const layout_cache&) = delete;
+
+    [[nodiscard]]
+    vk::DescriptorSetLayout acquire_descriptor_set_layout(std::span<const vk::DescriptorSetLayoutBinding> bindings);
+    void release_descriptor_set_layout(vk::DescriptorSetLayout layout);
+
+    // 'set_layouts' must come from acquire_descriptor_set_layout, handles are compared rather than contents
+    [[nodiscard]]
+    vk::PipelineLayout acquire_pipeline_layout(
+        std::span<const vk::DescriptorSetLayout> set_layouts,
+        std::span<const vk::PushConstantRange> push_constant_ranges
+    );
+    void release_pipeline_layout(vk::PipelineLayout layout);
+
+    [[nodiscard]]
+    statistics stats() const;
+private:
+    template<typename Handle>
+    struct entry {
+        Handle   handle;
+        uint32_t reference_count;
+    };
+
+    vk::Device device_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, entry<vk::DescriptorSetLayout>> descriptor_set_layouts_;
+    std::unordered_map<VkDescriptorSetLayout, std::string>          descriptor_set_layout_keys_;
+    std::unordered_map<std::string, entry<vk::PipelineLayout>>      pipeline_layouts_;
+    std::unordered_map<VkPipelineLayout, std::string>               pipeline_layout_keys_;
+    uint64_t descriptor_set_layout_reuses_ = 0;
+    uint64_t pipeline_layout_reuses_ = 0;
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <allocator.hpp>
+#include <typed_buffer.hpp>
+#include <vulkan_core.hpp>
+
+#include <vector>
+
+namespace vkengine {
+
+// A suballocation of a scratch_arena, only valid until the arena retires the frame it came from
+template<typename T>
+class scratch_buffer {
+public:
+    scratch_buffer(vk::Buffer buffer, vk::DeviceAddress address, vk::DeviceSize offset, uint64_t size)
+        : buffer_(buffer), address_(address), offset_(offset), size_(size) {}
+
+    operator device_span() const { return as_span(); }
+
+    vkengine::device_span as_span() const { return { address_, size_ }; }
+    vk::DeviceAddress device_address() const { return address_; }
+
+    vk::Buffer vk_handle() const { return buffer_; }
+    vk::DeviceSize offset() const { return offset_; }
+
+    uint64_t size() const { return size_; }
+    vk::DeviceSize size_bytes() const { return vk::DeviceSize(size_) * sizeof(T); }
+private:
+    vk::Buffer          buffer_;
+    vk::DeviceAddress   address_;
+    vk::DeviceSize      offset_;
+    uint64_t            size_;
+};
+
+// Operator temporaries (group sums, partial histograms, ...) are suballocated linearly from one device local
+// buffer with a VMA virtual block per frame in flight. A frame's allocations are released all at once: retire()
+// tags them with the timeline value of the submission using them and moves on to the next frame, which is
+// cleared once the semaphore has passed the value it was retired with. Not thread safe.
+class scratch_arena {
+public:
+    static constexpr vk::DeviceSize DEFAULT_FRAME_CAPACITY = 64ull << 20;
+    static constexpr uint32_t DEFAULT_FRAMES = 2;
+    static constexpr vk::DeviceSize MIN_ALIGNMENT = 16;
+
+    scratch_arena(
+        std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        vk::Semaphore timeline_semaphore,
+        vk::DeviceSize frame_capacity = DEFAULT_FRAME_CAPACITY,
+        uint32_t frames = DEFAULT_FRAMES
+    );
+    ~scratch_arena();
+
+    scratch_arena(const scratch_arena&) = delete;
+    scratch_arena& operator=(const scratch_arena&) = delete;
+
+    template<typename T>
+    scratch_buffer<T> allocate(uint64_t count, vk::DeviceSize alignment = alignof(T)) {
+        auto offset = allocate_bytes(vk::DeviceSize(count) * sizeof(T), alignment);
+        return scratch_buffer<T>(buffer_.handle, address_ + offset, offset, count);
+    }
+
+    // Everything allocated since the last retire() is in use until the timeline semaphore reaches timeline_value
+    void retire(uint64_t timeline_value);
+
+    [[nodiscard]]
+    vk::DeviceSize frame_capacity() const noexcept;
+private:
+    struct frame {
+        VmaVirtualBlock block = VK_NULL_HANDLE;
+        vk::DeviceSize  offset = 0;
+        uint64_t        timeline_value = 0;
+    };
+
+    vk::DeviceSize allocate_bytes(vk::DeviceSize size, vk::DeviceSize alignment);
+
+    std::reference_wrapper<allocator>   allocator_;
+    vk::Device                          device_;
+    vk::Semaphore                       timeline_semaphore_;
+    buffer                              buffer_;
+    vk::DeviceAddress                   address_;
+    vk::DeviceSize                      frame_capacity_;
+    std::vector<frame>                  frames_;
+    uint32_t                            current_frame_ = 0;
+};
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <shader_layout.hpp>
+#include <gpu.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vkengine {
+
+// A linked program as stored on disk. Descriptor set layout handles in 'root_layout'
+// are not persisted and come back null, the bindings are enough to recreate them.
+struct cached_program {
+    root_shader_object_layout           root_layout;
+    // Dead-code-stripped SPIR-V of each entry point, in the same order as root_layout.entry_points
+    std::vector<std::vector<uint32_t>>  entry_point_spirv;
+};
+
+// Content-addressed store of linked SPIR-V. Entries are named after a hash of the
+// full key text, and the key text itself is stored in the entry so that a hash
+// collision is reported as a miss rather than returning the wrong program.
+class shader_cache {
+public:
+    struct statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // An empty directory disables the cache, every lookup is then a miss
+    explicit shader_cache(std::filesystem::path directory);
+
+    shader_cache(const shader_cache&) = delete;
+    shader_cache& operator=(const shader_cache&) = delete;
+
+    [[nodiscard]]
+    std::optional<cached_program> load(const std::string& key);
+    void store(const std::string& key, const cached_program& program);
+
+    [[nodiscard]]
+    bool enabled() const noexcept;
+    [[nodiscard]]
+    statistics stats() const noexcept;
+    [[nodiscard]]
+    const std::filesystem::path& directory() const noexcept;
+private:
+    std::filesystem::path entry_path(const std::string& key) const;
+
+    std::filesystem::path   directory_;
+    std::atomic<uint64_t>   hits_ = 0;
+    std::atomic<uint64_t>   misses_ = 0;
+};
+
+// Driver-specific shader binaries from vkGetShaderBinaryDataEXT, one per entry point of a program.
+// Entries are keyed by the program key plus the device, driver and shaderBinaryUUID/Version, so a
+// driver update simply misses. A driver may still reject a binary, which is reported through
+// report_incompatible() and the entry is then overwritten with fresh binaries.
+class shader_binary_cache {
+public:
+    struct statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t incompatible = 0;
+    };
+
+    // An empty directory disables the cache, every lookup is then a miss
+    shader_binary_cache(std::filesystem::path directory, const gpu& gpu);
+
+    shader_binary_cache(const shader_binary_cache&) = delete;
+    shader_binary_cache& operator=(const shader_binary_cache&) = delete;
+
+    [[nodiscard]]
+    std::optional<std::vector<std::vector<uint8_t>>> load(const std::string& program_key);
+    void store(const std::string& program_key, const std::vector<std::vector<uint8_t>>& binaries);
+    void report_incompatible() noexcept;
+
+    [[nodiscard]]
+    bool enabled() const noexcept;
+    [[nodiscard]]
+    statistics stats() const noexcept;
+private:
+    std::filesystem::path entry_path(const std::string& key) const;
+
+    std::filesystem::path   directory_;
+    std::string             device_key_;
+    std::atomic<uint64_t>   hits_ = 0;
+    std::atomic<uint64_t>   misses_ = 0;
+    std::atomic<uint64_t>   incompatible_ = 0;
+};
+
+}
@@ -94,6 +94,7 @@ struct binding_range_info {
 
 struct descriptor_set_info {
 	std::vector<vk::DescriptorSetLayoutBinding>			bindings;
+	// Shared through the layout_cache, the builders leave this null
 	vk::DescriptorSetLayout								descriptor_set_layout;
 };
 
@@ -318,16 +319,9 @@ struct entry_point_layout_builder : shader_layout_builder_base {
 	}
 
 	[[nodiscard]]
-	entry_point_shader_layout build(vulkan_core& core) {
+	entry_point_shader_layout build() {
 		auto descriptor_sets = descriptor_set_bindings_ | std::views::transform([&](auto const& bindings) {
-			return descriptor_set_info {
-				.bindings = bindings.second,
-				.descriptor_set_layout = core.device().createDescriptorSetLayout(
-					vk::DescriptorSetLayoutCreateInfo()
-						.setBindings(bindings.second)
-						.setFlags(vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptor)
-				)
-			};
+			return descriptor_set_info { .bindings = bindings.second };
 		});
 
 		return entry_point_shader_layout {
@@ -349,20 +343,13 @@ struct root_shader_layout_builder {
 	global_shader_layout global_layout_;
 	std::vector<entry_point_shader_layout> entry_points_;
 
-	void add_global_params(slang::VariableLayoutReflection* globals_layout, vulkan_core& core) {
+	void add_global_params(slang::VariableLayoutReflection* globals_layout) {
 		shader_layout_builder_base builder;
 		binding_offset global_offset(globals_layout);
 		builder.add_descriptor_ranges_as_value(globals_layout->getTypeLayout(), global_offset);
 
 		auto descriptor_sets = builder.descriptor_set_bindings_ | std::views::transform([&](auto const& bindings) {
-			return descriptor_set_info {
-				.bindings = bindings.second,
-				.descriptor_set_layout = core.device().createDescriptorSetLayout(
-					vk::DescriptorSetLayoutCreateInfo()
-						.setBindings(bindings.second)
-						.setFlags(vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptor)
-				)
-			};
+			return descriptor_set_info { .bindings = bindings.second };
 		});
 
 		global_layout_ = global_shader_layout {
@@ -371,9 +358,9 @@ struct root_shader_layout_builder {
 		};
 	}
 
-	void add_entry_point(slang::EntryPointLayout* entry_point_layout, vulkan_core& core) {
+	void add_entry_point(slang::EntryPointLayout* entry_point_layout) {
 		entry_point_layout_builder builder(entry_point_layout);
-		entry_points_.emplace_back(builder.build(core));
+		entry_points_.emplace_back(builder.build());
 	}
 
 	[[nodiscard]]
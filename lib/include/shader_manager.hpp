@@ -1,12 +1,28 @@
 #pragma once
 
+#include <layout_cache.hpp>
+#include <shader_cache.hpp>
 #include <shader_layout.hpp>
 #include <vulkan_core.hpp>
+#include <workgroup_tuning.hpp>
+#include <utility/thread_pool.hpp>
 #include <type_traits>
 
 #include <slang-com-ptr.h>
 #include <slang.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <source_location>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace vkengine {
 
@@ -22,6 +38,13 @@ struct shader_program {
     std::vector<shader_entry_point> entry_points;
 };
 
+// Programs are shared by every caller that requests the same compilation. The shader_manager keeps a handle
+// to every program it loaded, so programs recorded into command buffers stay valid without the caller holding
+// one, and their Vulkan objects are destroyed with the manager or the last handle that outlives it.
+using shader_program_handle = std::shared_ptr<const shader_program>;
+
+class shader_source_watcher;
+
 class shader_manager {
 public:
     struct entry_point_compile_info {
@@ -29,31 +52,195 @@ public:
         std::vector<std::string>    specialisation_type_names;
     };
 
-    shader_manager(std::reference_wrapper<vulkan_core> vulkan);
+    // A module compiled from source and linked into a program, e.g. to inject workgroup sizes.
+    // The source is part of the program's cache key so it is kept as text rather than as a slang::IModule.
+    struct source_module {
+        std::string                 name;
+        std::string                 source;
+    };
+
+    struct program_compile_info {
+        std::string                             module_name;
+        std::vector<entry_point_compile_info>   entry_points;
+        std::vector<source_module>              modules;
+    };
+
+    // Linked programs are cached in 'cache_directory' and driver binaries of their shader objects in a
+    // subdirectory of it, pass an empty path to disable both on-disk caches.
+    // Asynchronous loads run on 'compile_worker_count' threads, each with its own Slang session.
+    shader_manager(
+        std::reference_wrapper<vulkan_core> vulkan,
+        std::filesystem::path cache_directory = VKENGINE_SHADER_CACHE_DIR,
+        uint32_t compile_worker_count = std::max(1u, std::thread::hardware_concurrency())
+    );
+    ~shader_manager();
 
     Slang::ComPtr<slang::IModule> create_shader_module_from_source_string(
         const std::string& source_string,
         const std::string& module_name
     );
-    shader_program load_shader(
+
+    // Identical requests return the same program, so this is cheap enough to call while recording.
+    // If the program is still being compiled in the background this waits for it.
+    shader_program_handle load_shader(const program_compile_info& program_info);
+    shader_program_handle load_shader(
         const std::string& module_name,
         const std::vector<entry_point_compile_info>& entry_point_infos,
-        const std::vector<Slang::ComPtr<slang::IModule>> modules
+        const std::vector<source_module>& modules
     );
+
+    std::shared_future<shader_program_handle> load_shader_async(const program_compile_info& program_info);
+
+    // Starts compiling every program in the background. Call this at boot with every operator the
+    // pipeline will use so that their constructors only find already loaded programs.
+    std::vector<std::shared_future<shader_program_handle>> warm_up(const std::vector<program_compile_info>& program_infos);
+
+    // Opt-in: watches VKENGINE_SHADER_DIR and recompiles, in the background, every loaded program that
+    // imports a changed file directly or indirectly. Rebuilt programs are only published by
+    // swap_reloaded_programs(), a program that fails to compile keeps running its previous version.
+    void enable_hot_reload(uint32_t frames_in_flight = 2);
+
+    // Call at a frame boundary, between recording frames. Afterwards load_shader returns the rebuilt programs.
+    // Replaced programs are kept alive for 'frames_in_flight' further calls so command buffers still
+    // executing them stay valid. Returns the number of programs swapped.
+    uint32_t swap_reloaded_programs();
+
+    // Bumped by every swap_reloaded_programs() that swapped programs in, see operator_programs
+    [[nodiscard]]
+    uint64_t program_generation() const noexcept;
+
+    [[nodiscard]]
+    shader_cache::statistics cache_statistics() const;
+    [[nodiscard]]
+    shader_binary_cache::statistics binary_cache_statistics() const;
+    [[nodiscard]]
+    layout_cache::statistics layout_statistics() const;
+
+    // Limits of the device programs are built for, for operators that size their dispatches
+    [[nodiscard]]
+    const vk::PhysicalDeviceLimits& device_limits() const noexcept;
+
+    // The device programs are built for, for operators that depend on optional features
+    [[nodiscard]]
+    const vkengine::gpu& gpu() const noexcept;
+
+    // Tuned workgroup sizes for this device, kept next to the program cache. See workgroup_autotuner.
+    [[nodiscard]]
+    workgroup_tuning& workgroup_sizes() noexcept;
 private:
-    void throw_exception_with_slang_diagnostics(const std::string& message, const std::source_location& location = std::source_location::current());
+    // ISession is not thread-safe, so every thread that compiles owns one of these
+    struct compile_context {
+        Slang::ComPtr<slang::IGlobalSession>    global_session;
+        Slang::ComPtr<slang::ISession>          session;
+        Slang::ComPtr<slang::IModule>           subgroup_module;
+        Slang::ComPtr<slang::IBlob>             diagnostics;
+        // Precompiled modules embedded in the library, keyed by module name
+        std::unordered_map<std::string_view, Slang::ComPtr<slang::IModule>> embedded_modules;
+        // A session keeps every module it loaded, so it is recreated once the sources on disk change
+        uint64_t                                source_generation = 0;
+    };
 
-    void setup_slang_session();
-    void create_subgroup_module();
+    // What is needed to rebuild a loaded program when one of its source files changes
+    struct loaded_program_sources {
+        program_compile_info                    compile_info;
+        std::set<std::filesystem::path>         files;
+        uint64_t                                reload_generation = 0;
+    };
+
+    [[noreturn]]
+    static void throw_exception_with_slang_diagnostics(
+        const compile_context& context,
+        const std::string& message,
+        const std::source_location& location = std::source_location::current()
+    );
+
+    compile_context create_compile_context() const;
+    void create_session(compile_context& context) const;
+    bool use_embedded_modules() const;
+    compile_context& current(compile_context& context) const;
+    compile_context& worker_context(uint32_t worker_index);
+    static Slang::ComPtr<slang::IModule> create_module_from_source(
+        compile_context& context,
+        const std::string& source_string,
+        const std::string& module_name
+    );
+
+    static std::string loaded_program_key(const program_compile_info& program_info);
+    std::string program_cache_key(const program_compile_info& program_info, std::set<std::filesystem::path>& source_files) const;
+    void forget_program(const std::string& program_key);
+    void on_sources_changed(const std::set<std::filesystem::path>& changed_files);
+
+    shader_program_handle build_program(compile_context& context, const program_compile_info& program_info);
+    cached_program compile_program(compile_context& context, const program_compile_info& program_info);
+    void acquire_descriptor_set_layouts(root_shader_object_layout& root_layout);
+    static void release_descriptor_set_layouts(layout_cache& layouts, const root_shader_object_layout& root_layout);
+    shader_program create_shader_objects(const cached_program& program, const std::string& cache_key);
+    static void destroy_shader_program(vk::Device device, layout_cache& layouts, const shader_program& program);
 
     std::reference_wrapper<vulkan_core>     vulkan;
+    vk::PhysicalDeviceLimits                limits;
+
+    std::string                             subgroup_module_source;
+    std::string                             slang_build_tag;
+    shader_cache                            program_cache;
+    shader_binary_cache                     binary_cache;
+    // Shared with the deleters of loaded programs, which may outlive the manager
+    std::shared_ptr<layout_cache>           layouts;
+    workgroup_tuning                        tuning;
+
+    // Bumped by hot reload whenever a shader file changes, initialised before the contexts that read it
+    std::atomic<uint64_t>                   source_generation = 0;
+    std::atomic<bool>                       hot_reload_enabled = false;
+    std::atomic<uint64_t>                   swapped_generation = 0;
+
+    std::mutex                              main_context_mutex;
+    compile_context                         main_context;
+    std::vector<std::unique_ptr<compile_context>> worker_contexts;
 
-    Slang::ComPtr<slang::IBlob>             diagnostics;
-    Slang::ComPtr<slang::IGlobalSession>    global_session;
-    Slang::ComPtr<slang::ISession>          session;
-    slang::SessionDesc                      session_desc;
-    slang::TargetDesc                       target_desc;
-    Slang::ComPtr<slang::IModule>           subgroup_module;
+    std::mutex                              loaded_programs_mutex;
+    std::unordered_map<std::string, std::shared_future<shader_program_handle>> loaded_programs;
+    std::unordered_map<std::string, loaded_program_sources> loaded_sources;
+
+    uint32_t                                reload_frames_in_flight = 0;
+    std::mutex                              reload_mutex;
+    std::unordered_map<std::string, shader_program_handle> reloaded_programs;
+    std::deque<std::vector<shader_program_handle>> retired_programs;
+
+    // Declared after everything the workers use so that they are joined first
+    thread_pool                             compile_pool;
+    // Submits to the pool, so it has to stop before the pool does
+    std::unique_ptr<shader_source_watcher>  source_watcher;
+};
+
+// The programs of an operator that records them over and over, one per variant 'TKey' (e.g. the layouts it was
+// specialised for). Operators load them in their constructors so that the first record() does not compile,
+// and record() only goes back to the shader_manager after hot reload swapped programs in, so recording costs
+// neither the key hash nor the lock of load_shader. Not thread safe, like the operators.
+template<typename TKey>
+class operator_programs {
+public:
+    explicit operator_programs(shader_manager& shader_manager)
+        : shader_manager_(shader_manager), generation_(shader_manager.program_generation()) {}
+
+    // 'make_program_info' is only called when the variant is not loaded yet
+    template<typename TMakeProgramInfo>
+    const shader_program_handle& get(const TKey& key, TMakeProgramInfo&& make_program_info) {
+        if (auto generation = shader_manager_.program_generation(); generation != generation_) {
+            programs_.clear();
+            generation_ = generation;
+        }
+
+        for (const auto& [program_key, program] : programs_)
+            if (program_key == key)
+                return program;
+
+        return programs_.emplace_back(key, shader_manager_.load_shader(make_program_info())).second;
+    }
+private:
+    shader_manager&                                     shader_manager_;
+    uint64_t                                            generation_;
+    // Operators have a handful of variants, a linear search beats hashing them
+    std::vector<std::pair<TKey, shader_program_handle>> programs_;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <allocator.hpp>
+#include <detailed_exception.hpp>
+#include <typed_buffer.hpp>
+#include <vulkan_core.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace vkengine {
+
+// A point on a timeline semaphore, for submissions that have to wait for work on another queue
+struct timeline_point {
+    vk::Semaphore   semaphore;
+    uint64_t        value = 0;
+
+    [[nodiscard]]
+    vk::SemaphoreSubmitInfo wait_info(vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eAllCommands) const {
+        return vk::SemaphoreSubmitInfo().setSemaphore(semaphore).setValue(value).setStageMask(stages);
+    }
+};
+
+// The buffer an upload creates, and the point its copies signal once they have completed
+template<typename T>
+struct staged_upload {
+    std::future<device_buffer<T>>   buffer;
+    timeline_point                  completed;
+};
+
+// Moves data between the host and device local buffers with copies on the transfer queue, so that it overlaps
+// with compute work. Copies go through a persistently mapped staging ring split into 'slots', one submission
+// each, so one slot can be filled while the others are in flight.
+//
+// Futures become ready once the copy has completed. Compute submissions that should not block the host can
+// wait on an upload's completed point instead, or on last_submitted() for every copy so far. Buffers created
+// here are shared between the transfer and compute queue families. Buffers passed to download() need the same,
+// create them with queue_families().
+class staging_engine {
+public:
+    static constexpr vk::DeviceSize DEFAULT_CAPACITY = 64ull << 20;
+    static constexpr uint32_t DEFAULT_SLOTS = 3;
+
+    staging_engine(
+        std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        vk::DeviceSize capacity = DEFAULT_CAPACITY,
+        uint32_t slots = DEFAULT_SLOTS
+    );
+    ~staging_engine();
+
+    staging_engine(const staging_engine&) = delete;
+    staging_engine& operator=(const staging_engine&) = delete;
+
+    template<typename T>
+    staged_upload<T> upload(std::span<const T> data) {
+        static_assert(std::is_trivially_copyable_v<T>, "Uploaded data must be trivially copyable.");
+        if (data.empty())
+            throw detailed_exception("Cannot upload an empty span");
+
+        // Shared, completions have to be copyable. A failed upload drops the buffer with the last reference.
+        auto buffer = std::make_shared<device_buffer<T>>(allocator_, core_, data.size(), queue_families());
+
+        auto promise = std::make_shared<std::promise<device_buffer<T>>>();
+        auto future = promise->get_future();
+
+        auto completed = record_upload(std::as_bytes(data), buffer->vk_handle(), buffer, [promise, buffer](std::exception_ptr error) {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value(std::move(*buffer));
+        });
+
+        return { .buffer = std::move(future), .completed = completed };
+    }
+
+    // 'after' is the point the producer of the buffer signals, e.g. the compute submission that wrote it
+    template<typename T, uint32_t dims, access_policy policy, buffer_kind kind>
+    std::future<std::vector<T>> download(
+        const typed_buffer<T, dims, policy, kind>& buffer,
+        std::optional<timeline_point> after = std::nullopt
+    ) {
+        static_assert(std::is_trivially_copyable_v<T>, "Downloaded data must be trivially copyable.");
+
+        auto result = std::make_shared<std::vector<T>>(buffer.size());
+        auto promise = std::make_shared<std::promise<std::vector<T>>>();
+        auto future = promise->get_future();
+
+        record_download(buffer.vk_handle(), std::as_writable_bytes(std::span(*result)), result, after,
+            [promise, result](std::exception_ptr error) {
+                if (error)
+                    promise->set_exception(error);
+                else
+                    promise->set_value(std::move(*result));
+            });
+
+        return future;
+    }
+
+    // Transfer and compute queue families, for buffers that the engine copies from or to
+    [[nodiscard]]
+    std::span<const uint32_t> queue_families() const noexcept;
+
+    // Signalled once every copy submitted so far has completed
+    [[nodiscard]]
+    timeline_point last_submitted() const;
+private:
+    enum class slot_state { free, recording, in_flight };
+
+    // Runs on the completion thread once the slot's submission finished, with the error if it failed
+    using completion = std::function<void(std::exception_ptr error)>;
+
+    struct slot {
+        vk::CommandBuffer                       cmd_buffer;
+        vk::DeviceSize                          offset;
+        vk::DeviceSize                          used = 0;
+        slot_state                              state = slot_state::free;
+        uint64_t                                timeline_value = 0;
+        std::vector<vk::SemaphoreSubmitInfo>    waits;
+        std::vector<completion>                 completions;
+    };
+
+    // Every chunk's completion holds on to destination_owner, chunks already in flight keep writing into
+    // destination when a later submission throws. record_upload returns the point its last chunk signals.
+    timeline_point record_upload(
+        std::span<const std::byte> data,
+        vk::Buffer destination,
+        std::shared_ptr<void> destination_owner,
+        completion on_complete
+    );
+    void record_download(
+        vk::Buffer source,
+        std::span<std::byte> destination,
+        std::shared_ptr<void> destination_owner,
+        std::optional<timeline_point> after,
+        completion on_complete
+    );
+
+    // Both expect mutex_ to be held
+    slot& begin_slot(std::unique_lock<std::mutex>& lock);
+    void submit_slot(slot& slot);
+
+    void complete(std::stop_token stop);
+
+    std::reference_wrapper<allocator>   allocator_;
+    const vulkan_core&                  core_;
+    std::vector<uint32_t>               queue_families_;
+    vk::Semaphore                       timeline_semaphore_;
+    buffer                              staging_;
+    vk::DeviceSize                      slot_size_;
+
+    mutable std::mutex                  mutex_;
+    std::condition_variable             slot_freed_;
+    std::condition_variable_any         submitted_;
+    std::vector<slot>                   slots_;
+    uint32_t                            current_slot_ = 0;
+    uint64_t                            timeline_value_ = 0;
+    std::deque<uint32_t>                in_flight_;
+
+    std::jthread                        completion_thread_;
+};
+
+}
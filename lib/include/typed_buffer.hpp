@@ -1,11 +1,18 @@
 ﻿#pragma once
+#include <concepts>
+#include <limits>
 #include <numeric>
+#include <span>
 #include <vulkan_core.hpp>
 #include <allocator.hpp>
+#include <detailed_exception.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace vkengine {
 
-enum buffer_kind { storage, uniform, vertex };
+enum buffer_kind { storage, uniform, vertex, indirect };
 
 template<buffer_kind Kind>
 struct buffer_kind_traits;
@@ -14,7 +21,20 @@ template<>
 struct buffer_kind_traits<buffer_kind::storage> {
     static constexpr vk::BufferUsageFlags usage =
         vk::BufferUsageFlagBits::eStorageBuffer |
-        vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        vk::BufferUsageFlagBits::eShaderDeviceAddress |
+        vk::BufferUsageFlagBits::eTransferSrc |
+        vk::BufferUsageFlagBits::eTransferDst;
+};
+
+// Storage that vkCmdDispatchIndirect can also read its arguments from
+template<>
+struct buffer_kind_traits<buffer_kind::indirect> {
+    static constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer |
+        vk::BufferUsageFlagBits::eShaderDeviceAddress |
+        vk::BufferUsageFlagBits::eIndirectBuffer |
+        vk::BufferUsageFlagBits::eTransferSrc |
+        vk::BufferUsageFlagBits::eTransferDst;
 };
 
 template<>
@@ -40,9 +60,14 @@ struct device_address_holder<true> {
 template<>
 struct device_address_holder<false>{};
 
-enum class access_policy { device, host_visible };
+// host_visible is for buffers the host writes, which may be write-combined and slow to read.
+// host_readback is for buffers the host reads back, e.g. histograms and processed frames, and prefers cached memory.
+enum class access_policy { device, host_visible, host_readback };
 template<access_policy P> struct allocation_policy_traits;
 
+template<access_policy P>
+concept host_accessible = (P != access_policy::device);
+
 template<>
 struct allocation_policy_traits<access_policy::device> {
     static VmaAllocationCreateInfo get_allocation_create_info() {
@@ -59,70 +84,268 @@ struct allocation_policy_traits<access_policy::host_visible> {
     }
 };
 
+template<>
+struct allocation_policy_traits<access_policy::host_readback> {
+    static VmaAllocationCreateInfo get_allocation_create_info() {
+        return { .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                            VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                    .usage = VMA_MEMORY_USAGE_AUTO,
+                    .preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT };
+    }
+};
+
 struct device_span {
     vk::DeviceAddress span;
-    uint32_t          size;
+    uint64_t          size;
 };
 
+// Strides are in elements, dense buffers have row-major strides
 template<uint32_t dims>
 struct device_mdspan {
     vk::DeviceAddress           span;
     std::array<uint32_t, dims>  dims;
+    std::array<uint64_t, dims>  strides;
 };
 
+template<uint32_t dims>
+std::array<uint64_t, dims> dense_strides(const std::array<uint32_t, dims>& shape) {
+    std::array<uint64_t, dims> strides;
+    uint64_t stride = 1;
+    for (int i = int(dims) - 1; i >= 0; --i) {
+        strides[i] = stride;
+        stride *= shape[i];
+    }
+    return strides;
+}
+
+// A region of interest of a typed_buffer, e.g. a tile of a frame, addressed in place through the strides of the
+// whole buffer. Only valid while the buffer is alive and not reallocated.
+template<typename T, uint32_t dims>
+class strided_view {
+public:
+    strided_view(vk::Buffer buffer, const device_mdspan<dims>& mdspan)
+        : buffer_(buffer), mdspan_(mdspan) {}
+
+    operator device_mdspan<dims>() const { return mdspan_; }
+    device_mdspan<dims> as_mdspan() const { return mdspan_; }
+
+    vk::Buffer vk_handle() const { return buffer_; }
+    const std::array<uint32_t, dims>& shape() const { return mdspan_.dims; }
+
+    uint64_t size() const {
+        uint64_t count = 1;
+        for (auto d : mdspan_.dims) count *= d;
+        return count;
+    }
+
+    // Contiguous views, e.g. bands of whole rows, can go through the 1D kernels, which vectorise their accesses
+    bool is_contiguous() const { return mdspan_.strides == dense_strides(mdspan_.dims); }
+
+    device_span as_span() const {
+        if (!is_contiguous())
+            throw detailed_exception("Only contiguous views can be addressed as a span");
+        return { mdspan_.span, size() };
+    }
+
+    strided_view subview(const std::array<uint32_t, dims>& offset, const std::array<uint32_t, dims>& extent) const {
+        vk::DeviceSize element_offset = 0;
+        for (uint32_t i = 0; i < dims; ++i) {
+            if (uint64_t(offset[i]) + extent[i] > mdspan_.dims[i])
+                throw detailed_exception("Subview of {} at {} exceeds dimension {} of {}", extent[i], offset[i], i, mdspan_.dims[i]);
+            element_offset += offset[i] * mdspan_.strides[i];
+        }
+
+        return { buffer_, { mdspan_.span + element_offset * sizeof(T), extent, mdspan_.strides } };
+    }
+private:
+    vk::Buffer          buffer_;
+    device_mdspan<dims> mdspan_;
+};
+
+// Element order of 2D buffers. Tiled buffers store LAYOUT_TILE_SIZE x LAYOUT_TILE_SIZE tiles contiguously, so that
+// the neighbourhoods stencil kernels read share cache lines. Their rows and columns are padded to whole tiles.
+// Convert between layouts with convert_layout(), see algorithms/convert_layout.hpp.
+enum class buffer_layout { linear, tiled };
+
+constexpr uint32_t LAYOUT_TILE_SIZE = 8;
+
+// The ILayout2D implementation in shaders/span.slang
+constexpr const char* layout_type_name(buffer_layout layout) {
+    return layout == buffer_layout::tiled ? "tiled_layout" : "linear_layout";
+}
+
 template<
     typename        T,
     uint32_t        dims = 1,
     access_policy   policy = access_policy::device,
-    buffer_kind     kind = buffer_kind::storage>
+    buffer_kind     kind = buffer_kind::storage,
+    buffer_layout   layout = buffer_layout::linear>
 class typed_buffer {
+    static_assert(layout == buffer_layout::linear || dims == 2, "Only 2D buffers can be tiled.");
 public:
+    // Buffers used from several queue families, e.g. the transfer and compute queue, pass them all to be
+    // created with concurrent sharing instead of needing ownership transfers
     typed_buffer(std::reference_wrapper<allocator> alloc,
         const vulkan_core& core,
+        const std::array<uint32_t, dims>& shape,
+        std::span<const uint32_t> queue_families = {})
+        : typed_buffer(alloc, core, shape, element_count(shape), queue_families) {
+    }
+
+    // 1D buffers can go past 4 G elements, device_mdspan<1> can not
+    template<uint32_t D = dims> requires (D == 1)
+        typed_buffer(std::reference_wrapper<allocator> alloc,
+            const vulkan_core& core,
+            uint64_t                          elements,
+            std::span<const uint32_t>         queue_families = {})
+        : typed_buffer(alloc, core, clamped_shape(elements), elements, queue_families) {
+    }
+
+    // Wraps host memory, e.g. a frame written by the acquisition driver, without copying it when the allocator can
+    // import it. Otherwise the memory is copied into a new host visible buffer. Imported memory has to outlive the buffer.
+    static typed_buffer import_host_memory(
+        std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        std::span<T> memory,
         const std::array<uint32_t, dims>& shape)
-        : allocator_{ alloc }, shape_{ shape } {
-        uint64_t cnt = 1;
-        for (auto d : shape) cnt *= d;
-        element_count_ = static_cast<uint32_t>(cnt);
+        requires (policy == access_policy::host_visible && device_addressable<kind> && layout == buffer_layout::linear) {
+        if (memory.size() != element_count(shape))
+            throw detailed_exception("Host memory of {} elements does not match the shape of {} elements", memory.size(), element_count(shape));
 
-        auto alloc_info = allocation_policy_traits<policy>::get_allocation_create_info();
-        buffer_ = allocator_.get().create_buffer(
+        auto imported = alloc.get().import_host_buffer(
             vk::BufferCreateInfo{}
-            .setSize(sizeof(T) * element_count_)
+            .setSize(memory.size_bytes())
             .setUsage(buffer_kind_traits<kind>::usage),
-            alloc_info);
+            memory.data());
 
-        if constexpr (device_addressable<kind>)
-            address_.set(core.device().getBufferAddress(
-                vk::BufferDeviceAddressInfo{}.setBuffer(buffer_.handle)));
+        if (imported)
+            return typed_buffer(alloc, core, shape, *imported);
+
+        typed_buffer copy(alloc, core, shape);
+        std::ranges::copy(memory, copy.mapping());
+        return copy;
     }
 
     template<uint32_t D = dims> requires (D == 1)
-        typed_buffer(std::reference_wrapper<allocator> alloc,
-            const vulkan_core& core,
-            uint32_t                          elements)
-        : typed_buffer(alloc, core, std::array<uint32_t, 1>{elements}) {
+    static typed_buffer import_host_memory(
+        std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        std::span<T> memory)
+        requires (policy == access_policy::host_visible && device_addressable<kind> && layout == buffer_layout::linear) {
+        if (memory.size() > std::numeric_limits<uint32_t>::max())
+            throw detailed_exception("Host memory of {} elements is too large to import", memory.size());
+        return import_host_memory(alloc, core, memory, std::array<uint32_t, 1>{ static_cast<uint32_t>(memory.size()) });
+    }
+
+    ~typed_buffer() { release(); }
+
+    typed_buffer(const typed_buffer&) = delete;
+    typed_buffer& operator=(const typed_buffer&) = delete;
+
+    typed_buffer(typed_buffer&& other) noexcept
+        : allocator_{ other.allocator_ },
+        device_{ other.device_ },
+        queue_families_{ std::move(other.queue_families_) },
+        buffer_{ std::exchange(other.buffer_, {}) },
+        shape_{ other.shape_ },
+        element_count_{ std::exchange(other.element_count_, 0) },
+        capacity_{ std::exchange(other.capacity_, 0) },
+        address_{ other.address_ } {
+    }
+
+    typed_buffer& operator=(typed_buffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            allocator_ = other.allocator_;
+            device_ = other.device_;
+            queue_families_ = std::move(other.queue_families_);
+            buffer_ = std::exchange(other.buffer_, {});
+            shape_ = other.shape_;
+            element_count_ = std::exchange(other.element_count_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+            address_ = other.address_;
+        }
+        return *this;
+    }
+
+    // Frees the buffer right away, only once the device no longer uses it. Dropping the buffer instead defers
+    // that to the allocator's deletion_queue when there is one.
+    void destroy() {
+        if (buffer_.handle)
+            allocator_.get().destroy_buffer(buffer_);
+        buffer_ = {};
+    }
+
+    bool is_imported() const { return bool(buffer_.imported_memory); }
+
+    // Changes the shape without reallocating while the elements fit the capacity, e.g. when switching binning
+    // modes. Growing past it reallocates with at least GROWTH_FACTOR times the capacity, which changes the device
+    // address and does not keep the contents. The old memory is retired like a dropped buffer.
+    void resize(const std::array<uint32_t, dims>& shape) {
+        reserve(storage_count(shape, element_count(shape)));
+        shape_ = shape;
+        element_count_ = element_count(shape);
+    }
+
+    template<uint32_t D = dims> requires (D == 1)
+    void resize(uint64_t elements) {
+        reserve(elements);
+        shape_ = clamped_shape(elements);
+        element_count_ = elements;
     }
 
-    void destroy() { allocator_.get().destroy_buffer(buffer_); }
+    void reserve(uint64_t elements) {
+        if (elements <= capacity_)
+            return;
+        if (is_imported())
+            throw detailed_exception("Cannot grow a buffer wrapping imported host memory");
+        reallocate(std::max<uint64_t>(elements, uint64_t(capacity_ * GROWTH_FACTOR)));
+    }
+
+    // Releases the capacity past size(), the only way a buffer gives memory back short of being dropped
+    void shrink_to_fit() {
+        auto storage = storage_count(shape_, element_count_);
+        if (capacity_ == storage || is_imported())
+            return;
+        reallocate(storage);
+    }
 
     operator device_mdspan<dims>() const
         requires device_addressable<kind> {
-        return { address_.get(), shape_};
+        return as_mdspan();
     }
 
     operator device_span() const
-        requires device_addressable<kind> {
+        requires (device_addressable<kind> && layout == buffer_layout::linear) {
         return { address_.get(), element_count_ };
     }
 
+    // Tiled buffers pass the elements per row of tiles and per tile as strides, see tiled_layout in span.slang
     device_mdspan<dims> as_mdspan() const
         requires device_addressable<kind> {
-        return { address_.get(), shape_ };
+        if (dims == 1 && element_count_ > std::numeric_limits<uint32_t>::max())
+            throw detailed_exception("Buffer of {} elements does not fit a device_mdspan<1>", element_count_);
+        if constexpr (layout == buffer_layout::tiled) {
+            uint64_t tile_elements = LAYOUT_TILE_SIZE * LAYOUT_TILE_SIZE;
+            return { address_.get(), shape_, { tiles(shape_[1]) * tile_elements, tile_elements } };
+        } else {
+            return { address_.get(), shape_, dense_strides(shape_) };
+        }
+    }
+
+    strided_view<T, dims> view() const
+        requires (device_addressable<kind> && layout == buffer_layout::linear) {
+        return { buffer_.handle, as_mdspan() };
+    }
+
+    // No copy, the view addresses the region inside this buffer
+    strided_view<T, dims> subview(const std::array<uint32_t, dims>& offset, const std::array<uint32_t, dims>& extent) const
+        requires (device_addressable<kind> && layout == buffer_layout::linear) {
+        return view().subview(offset, extent);
     }
 
     vkengine::device_span as_span() const
-        requires device_addressable<kind> {
+        requires (device_addressable<kind> && layout == buffer_layout::linear) {
         return { address_.get(), element_count_ };
     }
 
@@ -138,30 +361,134 @@ public:
         return shape_;
     }
 
-    uint32_t size() const { return element_count_; }
-    uint32_t size_bytes() const { return buffer_.size; }
+    uint64_t size() const { return element_count_; }
+    vk::DeviceSize size_bytes() const { return element_count_ * sizeof(T); }
+    uint64_t capacity() const { return capacity_; }
+    // Index into the device's memory types the buffer was allocated from
+    uint32_t memory_type() const { return buffer_.allocation_info.memoryType; }
 
     T* mapping() const 
-        requires (policy == access_policy::host_visible) {
+        requires host_accessible<policy> {
         if (auto* p = static_cast<T*>(buffer_.allocation_info.pMappedData); p)
             return p;
         throw detailed_exception("Buffer not mapped to host memory");
     }
 
+    // For host_readback buffers, only valid once the fence or timeline value of the submission that wrote the buffer
+    // has been waited on. Non-coherent memory is invalidated on every call, so call it after that wait.
     auto data() const 
-        requires (policy == access_policy::host_visible) {
+        requires (host_accessible<policy> && layout == buffer_layout::linear) {
+        if constexpr (policy == access_policy::host_readback)
+            allocator_.get().invalidate_buffer(buffer_, 0, VK_WHOLE_SIZE);
         return std::ranges::subrange(mapping(), mapping() + element_count_);
     }
 private:
+    void release() noexcept {
+        if (!buffer_.handle)
+            return;
+        try {
+            allocator_.get().retire_buffer(std::exchange(buffer_, {}));
+        } catch (const std::exception& e) {
+            spdlog::error("Failed to release buffer: {}", e.what());
+        }
+    }
+
+    static constexpr double GROWTH_FACTOR = 1.5;
+
+    void reallocate(uint64_t capacity) {
+        auto old = std::exchange(buffer_, allocate(capacity));
+        capacity_ = capacity;
+        update_address();
+        if (old.handle)
+            allocator_.get().retire_buffer(std::move(old));
+    }
+
+    buffer allocate(uint64_t capacity) const {
+        // Zero sized buffers are not allowed, an empty typed_buffer still owns one element
+        auto buffer_info = vk::BufferCreateInfo{}
+            .setSize(sizeof(T) * std::max<uint64_t>(capacity, 1))
+            .setUsage(buffer_kind_traits<kind>::usage);
+        if (queue_families_.size() > 1)
+            buffer_info
+                .setSharingMode(vk::SharingMode::eConcurrent)
+                .setQueueFamilyIndices(queue_families_);
+
+        auto alloc_info = allocation_policy_traits<policy>::get_allocation_create_info();
+        return allocator_.get().create_buffer(buffer_info, alloc_info);
+    }
+
+    void update_address() {
+        if constexpr (device_addressable<kind>)
+            address_.set(device_.getBufferAddress(
+                vk::BufferDeviceAddressInfo{}.setBuffer(buffer_.handle)));
+    }
+
+    static uint64_t tiles(uint32_t extent) {
+        return (uint64_t(extent) + LAYOUT_TILE_SIZE - 1) / LAYOUT_TILE_SIZE;
+    }
+
+    // Elements the memory has to hold, tiled buffers are padded to whole tiles
+    static uint64_t storage_count(const std::array<uint32_t, dims>& shape, uint64_t elements) {
+        if constexpr (layout == buffer_layout::tiled)
+            return tiles(shape[0]) * tiles(shape[1]) * LAYOUT_TILE_SIZE * LAYOUT_TILE_SIZE;
+        else
+            return elements;
+    }
+
+    static uint64_t element_count(const std::array<uint32_t, dims>& shape) {
+        uint64_t count = 1;
+        for (auto d : shape) count *= d;
+        return count;
+    }
+
+    static std::array<uint32_t, 1> clamped_shape(uint64_t elements) {
+        return { static_cast<uint32_t>(std::min<uint64_t>(elements, std::numeric_limits<uint32_t>::max())) };
+    }
+
+    typed_buffer(std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        const std::array<uint32_t, dims>& shape,
+        uint64_t elements,
+        std::span<const uint32_t> queue_families)
+        : allocator_{ alloc },
+        device_{ core.device() },
+        queue_families_(queue_families.begin(), queue_families.end()),
+        buffer_{ allocate(storage_count(shape, elements)) },
+        shape_{ shape },
+        element_count_{ elements },
+        capacity_{ storage_count(shape, elements) } {
+        update_address();
+    }
+
+    typed_buffer(std::reference_wrapper<allocator> alloc,
+        const vulkan_core& core,
+        const std::array<uint32_t, dims>& shape,
+        const buffer& imported)
+        : allocator_{ alloc }, device_{ core.device() }, buffer_{ imported }, shape_{ shape } {
+        element_count_ = capacity_ = imported.size / sizeof(T);
+        update_address();
+    }
+
     std::reference_wrapper<allocator>               allocator_;
+    vk::Device                                      device_;
+    std::vector<uint32_t>                           queue_families_;
     buffer                                          buffer_;
     std::array<uint32_t, dims>                      shape_;
-    uint32_t                                        element_count_{};
+    uint64_t                                        element_count_{};
+    uint64_t                                        capacity_{};
 
     [[no_unique_address]]
     device_address_holder<device_addressable<kind>> address_;
 };
 
+// A device addressable range of a vk::Buffer, e.g. a typed_buffer or a scratch_arena allocation
+template<typename T>
+concept device_buffer_view = requires(const T& buffer) {
+    { buffer.as_span() } -> std::convertible_to<device_span>;
+    { buffer.vk_handle() } -> std::convertible_to<vk::Buffer>;
+    { buffer.size() } -> std::convertible_to<uint64_t>;
+};
+
 template<typename T, uint32_t dims>
 using device_buffer_nd = typed_buffer<T, dims, access_policy::device>;
 template<typename T, uint32_t dims>
@@ -170,5 +497,11 @@ template<typename T>
 using device_buffer = device_buffer_nd<T, 1>;
 template<typename T>
 using host_visible_buffer = host_visible_buffer_nd<T, 1>;
+template<typename T, uint32_t dims>
+using host_readback_buffer_nd = typed_buffer<T, dims, access_policy::host_readback>;
+template<typename T>
+using host_readback_buffer = host_readback_buffer_nd<T, 1>;
+template<typename T>
+using tiled_device_buffer = typed_buffer<T, 2, access_policy::device, buffer_kind::storage, buffer_layout::tiled>;
 
 } // namespace vkengine
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace vkengine {
+
+constexpr uint64_t FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV1A_64_PRIME = 0x100000001b3ull;
+
+// 64-bit FNV-1a, stable across runs and platforms so it can be used for on-disk keys
+[[nodiscard]]
+constexpr uint64_t fnv1a_64(std::string_view bytes, uint64_t seed = FNV1A_64_OFFSET_BASIS) noexcept {
+    uint64_t hash = seed;
+    for (char c : bytes) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= FNV1A_64_PRIME;
+    }
+    return hash;
+}
+
+[[nodiscard]]
+inline uint64_t fnv1a_64(std::span<const std::byte> bytes, uint64_t seed = FNV1A_64_OFFSET_BASIS) noexcept {
+    return fnv1a_64(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()), seed);
+}
+
+[[nodiscard]]
+constexpr uint64_t hash_combine(uint64_t seed, uint64_t value) noexcept {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+} // namespace vkengine
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace vkengine {
+
+// Fixed size FIFO pool. Tasks receive the index of the worker running them so callers
+// can keep per-worker state (e.g. objects that are not thread-safe) without locking.
+// Tasks that have not started when the pool is destroyed are dropped.
+class thread_pool {
+public:
+  using task = std::move_only_function<void(uint32_t worker_index)>;
+
+  explicit thread_pool(uint32_t worker_count) {
+    workers_.reserve(worker_count);
+    for (uint32_t worker_index = 0; worker_index < worker_count; ++worker_index)
+      workers_.emplace_back([this, worker_index](std::stop_token stop) {
+        run(stop, worker_index);
+      });
+  }
+
+  ~thread_pool() {
+    for (auto &worker : workers_)
+      worker.request_stop();
+    condition_.notify_all();
+    workers_.clear();
+  }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  void submit(task t) {
+    {
+      std::lock_guard lock(mutex_);
+      tasks_.push_back(std::move(t));
+    }
+    condition_.notify_one();
+  }
+
+  [[nodiscard]]
+  uint32_t size() const noexcept {
+    return static_cast<uint32_t>(workers_.size());
+  }
+
+private:
+  void run(std::stop_token stop, uint32_t worker_index) {
+    while (true) {
+      task t;
+      {
+        std::unique_lock lock(mutex_);
+        if (!condition_.wait(lock, stop, [this] { return !tasks_.empty(); }))
+          return;
+
+        t = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      t(worker_index);
+    }
+  }
+
+  std::mutex                  mutex_;
+  std::condition_variable_any condition_;
+  std::deque<task>            tasks_;
+  std::vector<std::jthread>   workers_;
+};
+
+} // namespace vkengine
@@ -2,6 +2,9 @@
 
 #include <vulkan/vulkan_handles.hpp>
 #include <gpu.hpp>
+#include <mutex>
+#include <string>
+#include <string_view>
 
 namespace vkengine {
 
@@ -20,12 +23,14 @@ private:
     vk::Queue           transfer_queue_;
     uint32_t            transfer_queue_family_;
     vk::Queue           compute_queue_;
+    mutable std::mutex  compute_queue_mutex_;
     uint32_t            compute_queue_family_;
     vk::Queue           graphics_queue_;
     uint32_t            graphics_queue_family_;
     vk::CommandPool     transfer_pool_;
     vk::CommandPool     compute_pool_;
     vk::CommandPool     graphics_pool_;
+    std::vector<std::string> enabled_extensions_;
 
     static bool is_extension_available(const std::vector<vk::ExtensionProperties>& properties, const char* extension);
 
@@ -50,14 +55,21 @@ public:
     vk::Instance instance() const;
     vk::Device device() const;
 	vk::PhysicalDevice physical_device() const;
-	gpu gpu() const;
+	const gpu& gpu() const;
     vk::Queue graphics_queue() const;
     uint32_t graphics_queue_family() const;
     vk::CommandPool graphics_command_pool() const;
     vk::CommandPool compute_command_pool() const;
     vk::CommandPool transfer_command_pool() const;
     vk::Queue compute_queue() const;
+    // Submissions and sparse binds need the queue externally synchronised, hold this around every
+    // call on the compute queue that other threads may be making at the same time
+    [[nodiscard]]
+    std::unique_lock<std::mutex> lock_compute_queue() const;
+    uint32_t compute_queue_family() const;
     vk::Queue transfer_queue() const;
+    uint32_t transfer_queue_family() const;
+    bool is_extension_enabled(std::string_view extension) const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <shader_manager.hpp>
+#include <vulkan_core.hpp>
+#include <workgroup_tuning.hpp>
+
+#include <functional>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace vkengine {
+
+// Times candidate workgroup sizes of a kernel with GPU timestamp queries on the compute queue and stores
+// the fastest in the shader manager's workgroup_tuning, where operators look it up when they are constructed.
+class workgroup_autotuner {
+public:
+    // Records the work to time for one candidate, usually an operator built with that workgroup size
+    using record_function = std::function<void(vk::CommandBuffer cmd_buffer, workgroup_size size)>;
+
+    struct candidate_timing {
+        workgroup_size  size;
+        double          median_ms;
+    };
+
+    workgroup_autotuner(vulkan_core& core, shader_manager& shader_manager, uint32_t repetitions = 7);
+    ~workgroup_autotuner();
+
+    workgroup_autotuner(const workgroup_autotuner&) = delete;
+    workgroup_autotuner& operator=(const workgroup_autotuner&) = delete;
+
+    // Candidates that fail to compile or run are skipped. Throws if none of them works.
+    workgroup_size tune(const std::string& kernel, std::span<const workgroup_size> candidates, const record_function& record);
+
+    [[nodiscard]]
+    std::vector<candidate_timing> measure(std::span<const workgroup_size> candidates, const record_function& record);
+
+    // Powers of two within the device limits, optionally restricted to multiples of e.g. the subgroup size
+    [[nodiscard]]
+    static std::vector<workgroup_size> candidates_1d(
+        const gpu& gpu,
+        uint32_t multiple_of = 1,
+        uint32_t max_invocations = std::numeric_limits<uint32_t>::max()
+    );
+    [[nodiscard]]
+    static std::vector<workgroup_size> candidates_2d(
+        const gpu& gpu,
+        uint32_t max_invocations = std::numeric_limits<uint32_t>::max()
+    );
+private:
+    double time_submission(const record_function& record, workgroup_size size);
+
+    vulkan_core&        core_;
+    shader_manager&     shader_manager_;
+    uint32_t            repetitions_;
+    double              timestamp_period_ns_;
+    vk::CommandBuffer   cmd_buffer_;
+    vk::QueryPool       query_pool_;
+    vk::Fence           fence_;
+};
+
+}
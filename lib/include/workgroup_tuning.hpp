@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gpu.hpp>
+
+#include <array>
+#include <compare>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace vkengine {
+
+struct workgroup_size {
+    uint32_t x = 1;
+    uint32_t y = 1;
+    uint32_t z = 1;
+
+    [[nodiscard]]
+    uint32_t invocations() const noexcept { return x * y * z; }
+
+    auto operator<=>(const workgroup_size&) const = default;
+};
+
+// Tuned workgroup sizes per kernel, persisted in a text file named after the device UUID and driver version
+// so that results never carry over to another GPU or driver. Kernels without an entry use their defaults.
+class workgroup_tuning {
+public:
+    // An empty directory keeps results in memory only
+    workgroup_tuning(std::filesystem::path directory, const gpu& gpu);
+
+    workgroup_tuning(const workgroup_tuning&) = delete;
+    workgroup_tuning& operator=(const workgroup_tuning&) = delete;
+
+    [[nodiscard]]
+    std::optional<workgroup_size> find(const std::string& kernel) const;
+    [[nodiscard]]
+    workgroup_size get(const std::string& kernel, workgroup_size fallback) const;
+
+    // Records the result and rewrites the file
+    void set(const std::string& kernel, workgroup_size size);
+
+    [[nodiscard]]
+    const std::filesystem::path& file() const noexcept;
+private:
+    void save() const;
+
+    std::filesystem::path                   file_;
+    mutable std::mutex                      mutex_;
+    std::map<std::string, workgroup_size>   sizes_;
+};
+
+}
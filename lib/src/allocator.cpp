@@ -1,10 +1,33 @@
 #include <vulkan/vulkan.hpp>
 #include <vulkan_error.hpp>
 #include <allocator.hpp>
+#include <deletion_queue.hpp>
+#include <detailed_exception.hpp>
+#include <algorithm>
+#include <limits>
 
 namespace vkengine {
 
-allocator::allocator(const vulkan_core& core) {
+namespace {
+
+thread_local std::vector<std::string> allocation_tags;
+
+const std::string& current_tag() {
+    static const std::string untagged = "untagged";
+    return allocation_tags.empty() ? untagged : allocation_tags.back();
+}
+
+}
+
+allocation_tag::allocation_tag(std::string tag) {
+    allocation_tags.push_back(std::move(tag));
+}
+
+allocation_tag::~allocation_tag() {
+    allocation_tags.pop_back();
+}
+
+allocator::allocator(const vulkan_core& core) : core_(core), device_(core.device()) {
     spdlog::trace("Constructing {}", typeid(*this).name());
 
     const auto& d = VULKAN_HPP_DEFAULT_DISPATCHER;
@@ -14,8 +37,13 @@ allocator::allocator(const vulkan_core& core) {
         .vkGetDeviceProcAddr = d.vkGetDeviceProcAddr,
     };
 
+    VmaAllocatorCreateFlags flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    // Without it VMA estimates budgets as 80% of the heap sizes and only sees its own usage
+    if (core.is_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+        flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
     VmaAllocatorCreateInfo create_info {
-        .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
+        .flags = flags,
         .physicalDevice = core.physical_device(),
         .device = core.device(),
         .pVulkanFunctions = &functions,
@@ -24,14 +52,104 @@ allocator::allocator(const vulkan_core& core) {
     };
 
     VK_CHECK(vmaCreateAllocator(&create_info, &allocator_));
+
+    memory_properties_ = core.physical_device().getMemoryProperties();
+    peak_heap_usage_.resize(memory_properties_.memoryHeapCount);
+    over_budget_.resize(memory_properties_.memoryHeapCount);
+
+    auto properties = core.physical_device().getProperties2<
+        vk::PhysicalDeviceProperties2,
+        vk::PhysicalDeviceMaintenance3Properties,
+        vk::PhysicalDeviceMaintenance4Properties>();
+    max_allocation_size_ = properties.get<vk::PhysicalDeviceMaintenance3Properties>().maxMemoryAllocationSize;
+    max_buffer_size_ = properties.get<vk::PhysicalDeviceMaintenance4Properties>().maxBufferSize;
+
+    auto gpu = core.gpu();
+    if (gpu.features.features.sparseBinding &&
+        (gpu.queue_family_properties[core.compute_queue_family()].queueFlags & vk::QueueFlagBits::eSparseBinding))
+        sparse_queue_ = core.compute_queue();
+    if (core.is_extension_enabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+        host_import_alignment_ = core.gpu().external_memory_host_properties.minImportedHostPointerAlignment;
 }
 
 allocator::~allocator() {
     spdlog::trace("Destructing {}", typeid(*this).name());
 
+    for (const auto& [tag, statistics] : tag_statistics_)
+        if (statistics.allocations > 0)
+            spdlog::warn("{} allocations of {} bytes tagged \"{}\" are still alive", statistics.allocations, statistics.bytes, tag);
+
     vmaDestroyAllocator(allocator_);
 }
 
+void allocator::track(VmaAllocation allocation, const VmaAllocationInfo& allocation_info) const {
+    const auto& tag = current_tag();
+    vmaSetAllocationName(allocator_, allocation, tag.c_str());
+
+    {
+        std::lock_guard lock(telemetry_mutex_);
+        allocations_.emplace(allocation, tracked_allocation{ tag, allocation_info.size });
+
+        auto& statistics = tag_statistics_[tag];
+        statistics.bytes += allocation_info.size;
+        statistics.peak_bytes = std::max(statistics.peak_bytes, statistics.bytes);
+        statistics.allocations++;
+    }
+
+    check_budget(allocation_info.memoryType);
+}
+
+void allocator::untrack(VmaAllocation allocation) const {
+    std::lock_guard lock(telemetry_mutex_);
+    auto it = allocations_.find(allocation);
+    if (it == allocations_.end())
+        return;
+
+    auto& statistics = tag_statistics_[it->second.tag];
+    statistics.bytes -= it->second.size;
+    statistics.allocations--;
+    allocations_.erase(it);
+}
+
+void allocator::check_budget(uint32_t memory_type) const {
+    uint32_t heap_index = memory_properties_.memoryTypes[memory_type].heapIndex;
+
+    std::vector<VmaBudget> budgets(memory_properties_.memoryHeapCount);
+    vmaGetHeapBudgets(allocator_, budgets.data());
+    const auto& budget = budgets[heap_index];
+
+    std::optional<heap_budget> exceeded;
+    budget_callback callback;
+    {
+        std::lock_guard lock(telemetry_mutex_);
+        for (uint32_t i = 0; i < budgets.size(); ++i) {
+            peak_heap_usage_[i] = std::max(peak_heap_usage_[i], budgets[i].usage);
+            // Re-arms once usage has dropped back below the threshold
+            if (budgets[i].usage < budget_threshold_ * budgets[i].budget)
+                over_budget_[i] = false;
+        }
+
+        if (on_budget_ && !over_budget_[heap_index] && budget.usage >= budget_threshold_ * budget.budget) {
+            over_budget_[heap_index] = true;
+            callback = on_budget_;
+            exceeded = heap_budget {
+                .heap_index = heap_index,
+                .device_local = bool(memory_properties_.memoryHeaps[heap_index].flags & vk::MemoryHeapFlagBits::eDeviceLocal),
+                .usage = budget.usage,
+                .budget = budget.budget,
+                .peak_usage = peak_heap_usage_[heap_index],
+                .allocated_bytes = budget.statistics.allocationBytes
+            };
+        }
+    }
+
+    // Outside the lock, the callback may well free or allocate memory
+    if (exceeded) {
+        spdlog::warn("Memory heap {} at {} of its {} byte budget", heap_index, exceeded->usage, exceeded->budget);
+        callback(*exceeded);
+    }
+}
+
 image allocator::create_image(
     const vk::ImageCreateInfo& image_info,
     const VmaAllocationCreateInfo& allocation_create_info
@@ -48,6 +166,7 @@ image allocator::create_image(
     VmaAllocation allocation;
     VmaAllocationInfo allocation_info;
     VK_CHECK(vmaCreateImage(allocator_, &vk_image_info, &allocation_create_info, &handle, &allocation, &allocation_info));
+    track(allocation, allocation_info);
 
     return image {
         .handle = handle,
@@ -64,6 +183,7 @@ void allocator::destroy_image(image& image) const {
         image.extent.height,
         image.extent.depth);
 
+    untrack(image.allocation);
     vmaDestroyImage(allocator_, static_cast<VkImage>(image.handle), image.allocation);
 }
 
@@ -73,12 +193,18 @@ buffer allocator::create_buffer(
 ) const {
     spdlog::trace("Creating buffer of size {0} bytes", buffer_info.size);
 
+    if (buffer_info.size > max_buffer_size_)
+        throw detailed_exception("Buffer of {} bytes exceeds the device's maxBufferSize of {} bytes", buffer_info.size, max_buffer_size_);
+    if (buffer_info.size > max_allocation_size_ && sparse_queue_)
+        return create_chunked_buffer(buffer_info, allocation_create_info);
+
     VkBufferCreateInfo vk_buffer_info = static_cast<VkBufferCreateInfo>(buffer_info);
 
     VkBuffer handle;
     VmaAllocation allocation;
     VmaAllocationInfo allocation_info;
     VK_CHECK(vmaCreateBuffer(allocator_, &vk_buffer_info, &allocation_create_info, &handle, &allocation, &allocation_info));
+    track(allocation, allocation_info);
 
     return buffer {
         .handle = handle,
@@ -88,10 +214,250 @@ buffer allocator::create_buffer(
     };
 }
 
+buffer allocator::create_chunked_buffer(
+    const vk::BufferCreateInfo& buffer_info,
+    const VmaAllocationCreateInfo& allocation_create_info
+) const {
+    if (allocation_create_info.flags & VMA_ALLOCATION_CREATE_MAPPED_BIT)
+        throw detailed_exception("Buffer of {} bytes exceeds the allocation limit of {} bytes and cannot be host mapped",
+            buffer_info.size, max_allocation_size_);
+
+    auto handle = device_.createBuffer(vk::BufferCreateInfo(buffer_info).setFlags(buffer_info.flags | vk::BufferCreateFlagBits::eSparseBinding));
+    VkMemoryRequirements requirements = device_.getBufferMemoryRequirements(handle);
+
+    // The largest multiple of the sparse block size a single allocation can hold
+    VkMemoryRequirements chunk_requirements = requirements;
+    chunk_requirements.size = max_allocation_size_ / requirements.alignment * requirements.alignment;
+    size_t chunk_count = (requirements.size + chunk_requirements.size - 1) / chunk_requirements.size;
+
+    spdlog::debug("Chunking buffer of {} bytes into {} allocations", buffer_info.size, chunk_count);
+
+    // VMA_MEMORY_USAGE_AUTO needs a buffer to deduce the memory type from, which vmaAllocateMemoryPages does not have
+    VmaAllocationCreateInfo chunk_create_info = allocation_create_info;
+    chunk_create_info.usage = VMA_MEMORY_USAGE_UNKNOWN;
+    chunk_create_info.preferredFlags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    std::vector<VmaAllocation> chunks(chunk_count);
+    std::vector<VmaAllocationInfo> chunk_infos(chunk_count);
+    if (auto result = vmaAllocateMemoryPages(allocator_, &chunk_requirements, &chunk_create_info, chunk_count, chunks.data(), chunk_infos.data());
+        result != VK_SUCCESS) {
+        device_.destroyBuffer(handle);
+        VK_CHECK(result);
+    }
+
+    for (size_t i = 0; i < chunk_count; ++i)
+        track(chunks[i], chunk_infos[i]);
+
+    std::vector<vk::SparseMemoryBind> binds;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        vk::DeviceSize offset = i * chunk_requirements.size;
+        binds.push_back(vk::SparseMemoryBind()
+            .setResourceOffset(offset)
+            .setSize(std::min<vk::DeviceSize>(chunk_requirements.size, requirements.size - offset))
+            .setMemory(chunk_infos[i].deviceMemory)
+            .setMemoryOffset(chunk_infos[i].offset));
+    }
+
+    // Bound synchronously, the buffer is usable from any queue once this returns
+    auto buffer_binds = vk::SparseBufferMemoryBindInfo(handle, binds);
+    auto fence = device_.createFence({});
+    try {
+        {
+            auto queue_lock = core_.get().lock_compute_queue();
+            sparse_queue_.bindSparse(vk::BindSparseInfo().setBufferBinds(buffer_binds), fence);
+        }
+        (void)device_.waitForFences(fence, true, std::numeric_limits<uint64_t>::max());
+    } catch (...) {
+        device_.destroyFence(fence);
+        device_.destroyBuffer(handle);
+        for (auto chunk : chunks)
+            untrack(chunk);
+        vmaFreeMemoryPages(allocator_, chunks.size(), chunks.data());
+        throw;
+    }
+    device_.destroyFence(fence);
+
+    return buffer {
+        .handle = handle,
+        .size = buffer_info.size,
+        .allocation = VK_NULL_HANDLE,
+        .allocation_info = {},
+        .imported_memory = {},
+        .chunks = std::move(chunks)
+    };
+}
+
 void allocator::destroy_buffer(buffer& buffer) const {
     spdlog::trace("Destroying buffer of size {0} bytes", buffer.size);
 
+    if (buffer.imported_memory) {
+        device_.destroyBuffer(buffer.handle);
+        device_.freeMemory(buffer.imported_memory);
+        return;
+    }
+
+    if (!buffer.chunks.empty()) {
+        device_.destroyBuffer(buffer.handle);
+        for (auto chunk : buffer.chunks)
+            untrack(chunk);
+        vmaFreeMemoryPages(allocator_, buffer.chunks.size(), buffer.chunks.data());
+        buffer.chunks.clear();
+        return;
+    }
+
+    untrack(buffer.allocation);
     vmaDestroyBuffer(allocator_, static_cast<VkBuffer>(buffer.handle), buffer.allocation);
 }
 
+void allocator::retire_buffer(buffer buffer) const {
+    {
+        std::lock_guard lock(deletion_queue_mutex_);
+        if (deletion_queue_) {
+            deletion_queue_->retire(std::move(buffer));
+            return;
+        }
+    }
+
+    destroy_buffer(buffer);
+}
+
+void allocator::set_deletion_queue(deletion_queue* queue) {
+    std::lock_guard lock(deletion_queue_mutex_);
+    deletion_queue_ = queue;
+}
+
+std::optional<buffer> allocator::import_host_buffer(const vk::BufferCreateInfo& buffer_info, void* host_pointer) const {
+    constexpr auto handle_type = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT;
+
+    if (host_import_alignment_ == 0) {
+        spdlog::warn("Cannot import host memory, {} is not enabled", VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        return std::nullopt;
+    }
+    if (reinterpret_cast<uintptr_t>(host_pointer) % host_import_alignment_ != 0 || buffer_info.size % host_import_alignment_ != 0) {
+        spdlog::warn("Cannot import host memory at {} of {} bytes, pointer and size must be multiples of {} bytes",
+            host_pointer, buffer_info.size, host_import_alignment_);
+        return std::nullopt;
+    }
+
+    auto pointer_properties = device_.getMemoryHostPointerPropertiesEXT(handle_type, host_pointer);
+
+    auto external_info = vk::ExternalMemoryBufferCreateInfo().setHandleTypes(handle_type);
+    auto create_info = vk::BufferCreateInfo(buffer_info).setPNext(&external_info);
+    auto handle = device_.createBuffer(create_info);
+
+    auto requirements = device_.getBufferMemoryRequirements(handle);
+    uint32_t memory_types = requirements.memoryTypeBits & pointer_properties.memoryTypeBits;
+
+    // Host coherent types only, imported buffers are used like mapped host visible ones without flushes
+    std::optional<uint32_t> memory_type;
+    for (uint32_t i = 0; i < memory_properties_.memoryTypeCount && !memory_type; ++i)
+        if ((memory_types & (1u << i)) &&
+            (memory_properties_.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent))
+            memory_type = i;
+
+    if (!memory_type) {
+        spdlog::warn("Cannot import host memory at {}, no host coherent memory type accepts it", host_pointer);
+        device_.destroyBuffer(handle);
+        return std::nullopt;
+    }
+
+    auto import_info = vk::ImportMemoryHostPointerInfoEXT()
+        .setHandleType(handle_type)
+        .setPHostPointer(host_pointer);
+    auto flags_info = vk::MemoryAllocateFlagsInfo()
+        .setFlags(vk::MemoryAllocateFlagBits::eDeviceAddress)
+        .setPNext(&import_info);
+
+    vk::DeviceMemory memory;
+    try {
+        memory = device_.allocateMemory(
+            vk::MemoryAllocateInfo()
+                .setAllocationSize(buffer_info.size)
+                .setMemoryTypeIndex(*memory_type)
+                .setPNext(&flags_info));
+        device_.bindBufferMemory(handle, memory, 0);
+    } catch (...) {
+        device_.freeMemory(memory);
+        device_.destroyBuffer(handle);
+        throw;
+    }
+
+    spdlog::trace("Imported host memory at {} as buffer of size {} bytes", host_pointer, buffer_info.size);
+
+    return buffer {
+        .handle = handle,
+        .size = buffer_info.size,
+        .allocation = VK_NULL_HANDLE,
+        .allocation_info = VmaAllocationInfo { .pMappedData = host_pointer },
+        .imported_memory = memory
+    };
+}
+
+vk::DeviceSize allocator::host_import_alignment() const {
+    return host_import_alignment_;
+}
+
+void allocator::flush_buffer(const buffer& buffer, vk::DeviceSize offset, vk::DeviceSize size) const {
+    if (buffer.imported_memory)
+        return;
+    VK_CHECK(vmaFlushAllocation(allocator_, buffer.allocation, offset, size));
+}
+
+void allocator::invalidate_buffer(const buffer& buffer, vk::DeviceSize offset, vk::DeviceSize size) const {
+    if (buffer.imported_memory)
+        return;
+    VK_CHECK(vmaInvalidateAllocation(allocator_, buffer.allocation, offset, size));
+}
+
+std::unordered_map<std::string, tag_statistics> allocator::statistics_by_tag() const {
+    std::lock_guard lock(telemetry_mutex_);
+    return tag_statistics_;
+}
+
+std::vector<heap_budget> allocator::heap_budgets() const {
+    std::vector<VmaBudget> budgets(memory_properties_.memoryHeapCount);
+    vmaGetHeapBudgets(allocator_, budgets.data());
+
+    std::lock_guard lock(telemetry_mutex_);
+    std::vector<heap_budget> heaps;
+    for (uint32_t i = 0; i < budgets.size(); ++i) {
+        peak_heap_usage_[i] = std::max(peak_heap_usage_[i], budgets[i].usage);
+        heaps.push_back(heap_budget {
+            .heap_index = i,
+            .device_local = bool(memory_properties_.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal),
+            .usage = budgets[i].usage,
+            .budget = budgets[i].budget,
+            .peak_usage = peak_heap_usage_[i],
+            .allocated_bytes = budgets[i].statistics.allocationBytes
+        });
+    }
+    return heaps;
+}
+
+vk::DeviceSize allocator::available_device_memory() const {
+    vk::DeviceSize available = 0;
+    for (const auto& heap : heap_budgets())
+        if (heap.device_local && heap.usage < heap.budget)
+            available += heap.budget - heap.usage;
+    return available;
+}
+
+std::string allocator::statistics_json(bool detailed) const {
+    char* stats = nullptr;
+    vmaBuildStatsString(allocator_, &stats, detailed ? VK_TRUE : VK_FALSE);
+    std::string json(stats);
+    vmaFreeStatsString(allocator_, stats);
+    return json;
+}
+
+void allocator::set_budget_callback(budget_callback callback, float threshold) {
+    if (threshold <= 0.0f)
+        throw detailed_exception("Budget threshold must be positive, got {}", threshold);
+
+    std::lock_guard lock(telemetry_mutex_);
+    on_budget_ = std::move(callback);
+    budget_threshold_ = threshold;
+    std::ranges::fill(over_budget_, false);
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include <argument_ring.hpp>
+#include <detailed_exception.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <limits>
+
+namespace vkengine {
+
+namespace {
+
+vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+argument_ring::argument_ring(
+    std::reference_wrapper<allocator> alloc,
+    const vulkan_core& core,
+    vk::Semaphore timeline_semaphore,
+    vk::DeviceSize capacity
+) : allocator_(alloc), device_(core.device()), timeline_semaphore_(timeline_semaphore) {
+    spdlog::trace("Constructing {}", typeid(*this).name());
+
+    allocation_tag tag("argument_ring");
+    buffer_ = allocator_.get().create_buffer(
+        vk::BufferCreateInfo{}
+            .setSize(align_up(capacity, ALIGNMENT))
+            .setUsage(buffer_kind_traits<buffer_kind::storage>::usage),
+        allocation_policy_traits<access_policy::host_visible>::get_allocation_create_info());
+
+    if (!buffer_.allocation_info.pMappedData) {
+        allocator_.get().destroy_buffer(buffer_);
+        throw detailed_exception("Argument ring buffer is not mapped to host memory");
+    }
+
+    address_ = device_.getBufferAddress(vk::BufferDeviceAddressInfo{}.setBuffer(buffer_.handle));
+}
+
+argument_ring::~argument_ring() {
+    spdlog::trace("Destructing {}", typeid(*this).name());
+
+    // Submissions still reading arguments have to finish before the memory goes away
+    if (!retired_.empty()) {
+        auto wait_info = vk::SemaphoreWaitInfo()
+            .setSemaphores(timeline_semaphore_)
+            .setValues(retired_.back().timeline_value);
+        (void)device_.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+    }
+
+    allocator_.get().destroy_buffer(buffer_);
+}
+
+vk::DeviceAddress argument_ring::write_bytes(std::span<const std::byte> bytes, vk::DeviceSize alignment) {
+    const auto capacity = buffer_.size;
+    const auto size = static_cast<vk::DeviceSize>(bytes.size());
+    alignment = std::max(alignment, ALIGNMENT);
+
+    if (size > capacity)
+        throw detailed_exception("Arguments of {} bytes exceed the ring capacity of {} bytes", size, capacity);
+
+    for (;;) {
+        auto offset = align_up(head_, alignment);
+        // Arguments never wrap around the end of the buffer
+        if (offset % capacity + size > capacity)
+            offset = align_up(offset, capacity);
+
+        if (offset + size - tail_ <= capacity) {
+            auto position = offset % capacity;
+            std::memcpy(static_cast<std::byte*>(buffer_.allocation_info.pMappedData) + position, bytes.data(), bytes.size());
+            allocator_.get().flush_buffer(buffer_, position, size);
+
+            head_ = offset + size;
+            return address_ + position;
+        }
+
+        if (retired_.empty())
+            throw detailed_exception("Arguments of a single submission exceed the ring capacity of {} bytes", capacity);
+
+        reclaim(true);
+    }
+}
+
+void argument_ring::retire(uint64_t timeline_value) {
+    auto written_since = retired_.empty() ? tail_ : retired_.back().end;
+    if (head_ != written_since)
+        retired_.push_back({ .end = head_, .timeline_value = timeline_value });
+
+    reclaim(false);
+}
+
+void argument_ring::reclaim(bool wait) {
+    auto completed = device_.getSemaphoreCounterValue(timeline_semaphore_);
+
+    if (wait && !retired_.empty() && retired_.front().timeline_value > completed) {
+        spdlog::debug("Argument ring is full, waiting for timeline value {}", retired_.front().timeline_value);
+
+        auto wait_info = vk::SemaphoreWaitInfo()
+            .setSemaphores(timeline_semaphore_)
+            .setValues(retired_.front().timeline_value);
+        (void)device_.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+        completed = retired_.front().timeline_value;
+    }
+
+    while (!retired_.empty() && retired_.front().timeline_value <= completed) {
+        tail_ = retired_.front().end;
+        retired_.pop_front();
+    }
+}
+
+vk::DeviceSize argument_ring::capacity() const noexcept {
+    return buffer_.size;
+}
+
+vk::DeviceSize argument_ring::in_use() const noexcept {
+    return head_ - tail_;
+}
+
+}
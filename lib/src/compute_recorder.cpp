@@ -0,0 +1,91 @@
+#include <compute_recorder.hpp>
+#include <detailed_exception.hpp>
+#include <algorithm>
+
+namespace vkengine {
+
+compute_recorder::compute_recorder(vk::CommandBuffer cmd_buffer) : cmd_buffer_(cmd_buffer) {}
+
+vk::CommandBuffer compute_recorder::command_buffer() const noexcept {
+    return cmd_buffer_;
+}
+
+void compute_recorder::bind_shader(const shader_entry_point& shader, vk::ShaderStageFlagBits stage) {
+    if (bound_shader_ == shader.shader_ext && bound_stage_ == stage) {
+        stats_.shader_binds_elided++;
+        return;
+    }
+
+    cmd_buffer_.bindShadersEXT(stage, { shader.shader_ext });
+    bound_shader_ = shader.shader_ext;
+    bound_stage_ = stage;
+    stats_.shader_binds++;
+}
+
+void compute_recorder::push_constants(const shader_entry_point& shader, std::span<const std::byte> bytes) {
+    const auto& range = shader.push_constant_range;
+
+    if (bytes.size() != range.size || range.offset + range.size > PUSH_CONSTANT_CAPACITY)
+        throw detailed_exception("Push constants of {} bytes do not match the shader's range of {} bytes", bytes.size(), range.size);
+
+    auto shadow = std::span(push_constant_bytes_).subspan(range.offset, range.size);
+
+    uint32_t first = 0;
+    uint32_t last = range.size;
+
+    if (push_constants_valid_ && push_constant_range_ == range) {
+        while (first < range.size && bytes[first] == shadow[first])
+            first++;
+        if (first == range.size) {
+            stats_.push_constant_updates_elided++;
+            return;
+        }
+        while (bytes[last - 1] == shadow[last - 1])
+            last--;
+
+        // vkCmdPushConstants wants offset and size in multiples of 4
+        first &= ~3u;
+        last = std::min(range.size, (last + 3u) & ~3u);
+    }
+
+    cmd_buffer_.pushConstants(
+        shader.pipeline_layout,
+        range.stageFlags,
+        range.offset + first,
+        last - first,
+        bytes.data() + first
+    );
+
+    std::ranges::copy(bytes, shadow.begin());
+    push_constant_range_ = range;
+    push_constants_valid_ = true;
+
+    stats_.push_constant_updates++;
+    stats_.push_constant_bytes += last - first;
+}
+
+void compute_recorder::dispatch(const std::array<uint32_t, 3>& group_counts) {
+    cmd_buffer_.dispatch(group_counts[0], group_counts[1], group_counts[2]);
+    stats_.dispatches++;
+}
+
+void compute_recorder::dispatch_indirect(vk::Buffer buffer, vk::DeviceSize offset) {
+    cmd_buffer_.dispatchIndirect(buffer, offset);
+    stats_.indirect_dispatches++;
+}
+
+void compute_recorder::pipeline_barrier(const vk::DependencyInfo& dependency_info) {
+    cmd_buffer_.pipelineBarrier2(dependency_info);
+    stats_.barriers++;
+}
+
+void compute_recorder::invalidate() noexcept {
+    bound_shader_ = nullptr;
+    push_constants_valid_ = false;
+}
+
+const compute_recorder::statistics& compute_recorder::stats() const noexcept {
+    return stats_;
+}
+
+}
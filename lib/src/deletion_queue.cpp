@@ -0,0 +1,85 @@
+#include <deletion_queue.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <limits>
+
+namespace vkengine {
+
+deletion_queue::deletion_queue(
+    std::reference_wrapper<allocator> alloc,
+    const vulkan_core& core,
+    vk::Semaphore timeline_semaphore
+) : allocator_(alloc), device_(core.device()), timeline_semaphore_(timeline_semaphore) {
+    spdlog::trace("Constructing {}", typeid(*this).name());
+
+    allocator_.get().set_deletion_queue(this);
+    deletion_thread_ = std::jthread([this](std::stop_token stop) { free_retired(stop); });
+}
+
+deletion_queue::~deletion_queue() {
+    spdlog::trace("Destructing {}", typeid(*this).name());
+
+    // Waits for buffers other threads are retiring right now, buffers dropped from here on are freed right away
+    allocator_.get().set_deletion_queue(nullptr);
+
+    // The deletion thread frees what is still retired before it exits
+    deletion_thread_.request_stop();
+    deletion_thread_.join();
+}
+
+void deletion_queue::submitted(uint64_t timeline_value) {
+    std::lock_guard lock(mutex_);
+    timeline_value_ = std::max(timeline_value_, timeline_value);
+}
+
+void deletion_queue::retire(buffer buffer) {
+    {
+        std::lock_guard lock(mutex_);
+        retired_.push_back({ std::move(buffer), timeline_value_ });
+    }
+    retired_cv_.notify_one();
+}
+
+size_t deletion_queue::pending() const {
+    std::lock_guard lock(mutex_);
+    return retired_.size();
+}
+
+void deletion_queue::free_retired(std::stop_token stop) {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        // Returns false only when stopping with nothing left to free
+        if (!retired_cv_.wait(lock, stop, [&] { return !retired_.empty(); }))
+            return;
+
+        // Values are retired in order, everything up to the newest one is freed after a single wait
+        auto timeline_value = retired_.back().timeline_value;
+        lock.unlock();
+
+        try {
+            auto wait_info = vk::SemaphoreWaitInfo()
+                .setSemaphores(timeline_semaphore_)
+                .setValues(timeline_value);
+            (void)device_.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+        } catch (...) {
+            // Freeing memory the device may still use is worse than leaking it
+            spdlog::error("Waiting for timeline value {} failed, leaking retired buffers", timeline_value);
+            lock.lock();
+            while (!retired_.empty() && retired_.front().timeline_value <= timeline_value)
+                retired_.pop_front();
+            continue;
+        }
+
+        lock.lock();
+        while (!retired_.empty() && retired_.front().timeline_value <= timeline_value) {
+            auto retired = std::move(retired_.front());
+            retired_.pop_front();
+
+            lock.unlock();
+            allocator_.get().destroy_buffer(retired.buffer);
+            lock.lock();
+        }
+    }
+}
+
+}
@@ -0,0 +1,156 @@
+#include <vulkan/vulkan.hpp>
+#include <layout_cache.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cassert>
+#include <ranges>
+
+namespace {
+
+template<typename T> requires std::is_trivially_copyable_v<T>
+void append_bytes(std::string& key, const T& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Bindings are keyed in binding order so that reflection order does not create duplicate layouts
+std::string descriptor_set_layout_key(std::span<const vk::DescriptorSetLayoutBinding> bindings) {
+    auto sorted_bindings = bindings | std::ranges::to<std::vector>();
+    std::ranges::sort(sorted_bindings, {}, &vk::DescriptorSetLayoutBinding::binding);
+
+    std::string key;
+    for (const auto& binding : sorted_bindings) {
+        append_bytes(key, binding.binding);
+        append_bytes(key, binding.descriptorType);
+        append_bytes(key, binding.descriptorCount);
+        append_bytes(key, binding.stageFlags);
+    }
+    return key;
+}
+
+std::string pipeline_layout_key(
+    std::span<const vk::DescriptorSetLayout> set_layouts,
+    std::span<const vk::PushConstantRange> push_constant_ranges
+) {
+    std::string key;
+    append_bytes(key, static_cast<uint32_t>(set_layouts.size()));
+    for (auto set_layout : set_layouts)
+        append_bytes(key, static_cast<VkDescriptorSetLayout>(set_layout));
+
+    for (const auto& range : push_constant_ranges) {
+        append_bytes(key, range.stageFlags);
+        append_bytes(key, range.offset);
+        append_bytes(key, range.size);
+    }
+    return key;
+}
+
+}
+
+namespace vkengine {
+
+layout_cache::layout_cache(vk::Device device) : device_(device) {}
+
+layout_cache::~layout_cache() {
+    if (!pipeline_layouts_.empty() || !descriptor_set_layouts_.empty())
+        spdlog::warn("Destroying layout cache with {} pipeline layouts and {} descriptor set layouts still referenced",
+            pipeline_layouts_.size(), descriptor_set_layouts_.size());
+
+    for (auto& [key, entry] : pipeline_layouts_)
+        device_.destroyPipelineLayout(entry.handle);
+    for (auto& [key, entry] : descriptor_set_layouts_)
+        device_.destroyDescriptorSetLayout(entry.handle);
+}
+
+vk::DescriptorSetLayout layout_cache::acquire_descriptor_set_layout(std::span<const vk::DescriptorSetLayoutBinding> bindings) {
+    std::string key = descriptor_set_layout_key(bindings);
+
+    std::lock_guard lock(mutex_);
+
+    if (auto it = descriptor_set_layouts_.find(key); it != descriptor_set_layouts_.end()) {
+        it->second.reference_count++;
+        descriptor_set_layout_reuses_++;
+        return it->second.handle;
+    }
+
+    auto layout = device_.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo()
+            .setBindings(bindings)
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptor)
+    );
+
+    descriptor_set_layout_keys_.emplace(layout, key);
+    descriptor_set_layouts_.emplace(std::move(key), entry<vk::DescriptorSetLayout> { .handle = layout, .reference_count = 1 });
+    return layout;
+}
+
+void layout_cache::release_descriptor_set_layout(vk::DescriptorSetLayout layout) {
+    if (!layout)
+        return;
+
+    std::lock_guard lock(mutex_);
+
+    auto key_it = descriptor_set_layout_keys_.find(layout);
+    assert(key_it != descriptor_set_layout_keys_.end() && "descriptor set layout was not acquired from this cache");
+
+    auto it = descriptor_set_layouts_.find(key_it->second);
+    if (--it->second.reference_count == 0) {
+        device_.destroyDescriptorSetLayout(layout);
+        descriptor_set_layouts_.erase(it);
+        descriptor_set_layout_keys_.erase(key_it);
+    }
+}
+
+vk::PipelineLayout layout_cache::acquire_pipeline_layout(
+    std::span<const vk::DescriptorSetLayout> set_layouts,
+    std::span<const vk::PushConstantRange> push_constant_ranges
+) {
+    std::string key = pipeline_layout_key(set_layouts, push_constant_ranges);
+
+    std::lock_guard lock(mutex_);
+
+    if (auto it = pipeline_layouts_.find(key); it != pipeline_layouts_.end()) {
+        it->second.reference_count++;
+        pipeline_layout_reuses_++;
+        return it->second.handle;
+    }
+
+    auto layout = device_.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo{}
+        .setSetLayouts(set_layouts)
+        .setPushConstantRanges(push_constant_ranges)
+    );
+
+    pipeline_layout_keys_.emplace(layout, key);
+    pipeline_layouts_.emplace(std::move(key), entry<vk::PipelineLayout> { .handle = layout, .reference_count = 1 });
+    return layout;
+}
+
+void layout_cache::release_pipeline_layout(vk::PipelineLayout layout) {
+    if (!layout)
+        return;
+
+    std::lock_guard lock(mutex_);
+
+    auto key_it = pipeline_layout_keys_.find(layout);
+    assert(key_it != pipeline_layout_keys_.end() && "pipeline layout was not acquired from this cache");
+
+    auto it = pipeline_layouts_.find(key_it->second);
+    if (--it->second.reference_count == 0) {
+        device_.destroyPipelineLayout(layout);
+        pipeline_layouts_.erase(it);
+        pipeline_layout_keys_.erase(key_it);
+    }
+}
+
+layout_cache::statistics layout_cache::stats() const {
+    std::lock_guard lock(mutex_);
+
+    return statistics {
+        .descriptor_set_layouts = descriptor_set_layouts_.size(),
+        .pipeline_layouts = pipeline_layouts_.size(),
+        .descriptor_set_layout_reuses = descriptor_set_layout_reuses_,
+        .pipeline_layout_reuses = pipeline_layout_reuses_
+    };
+}
+
+}
@@ -0,0 +1,104 @@
+#include <vulkan/vulkan.hpp>
+#include <scratch_arena.hpp>
+#include <detailed_exception.hpp>
+#include <vulkan_error.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <limits>
+
+namespace vkengine {
+
+scratch_arena::scratch_arena(
+    std::reference_wrapper<allocator> alloc,
+    const vulkan_core& core,
+    vk::Semaphore timeline_semaphore,
+    vk::DeviceSize frame_capacity,
+    uint32_t frames
+) : allocator_(alloc),
+    device_(core.device()),
+    timeline_semaphore_(timeline_semaphore),
+    frame_capacity_((frame_capacity + MIN_ALIGNMENT - 1) / MIN_ALIGNMENT * MIN_ALIGNMENT) {
+    spdlog::trace("Constructing {}", typeid(*this).name());
+
+    if (frames == 0)
+        throw detailed_exception("The scratch arena needs at least one frame");
+
+    allocation_tag tag("scratch_arena");
+    buffer_ = allocator_.get().create_buffer(
+        vk::BufferCreateInfo{}
+            .setSize(frame_capacity_ * frames)
+            .setUsage(buffer_kind_traits<buffer_kind::storage>::usage),
+        allocation_policy_traits<access_policy::device>::get_allocation_create_info());
+    address_ = device_.getBufferAddress(vk::BufferDeviceAddressInfo{}.setBuffer(buffer_.handle));
+
+    frames_.resize(frames);
+    for (uint32_t i = 0; i < frames; ++i) {
+        VmaVirtualBlockCreateInfo block_info {
+            .size = frame_capacity_,
+            .flags = VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT
+        };
+        VK_CHECK(vmaCreateVirtualBlock(&block_info, &frames_[i].block));
+        frames_[i].offset = i * frame_capacity_;
+    }
+}
+
+scratch_arena::~scratch_arena() {
+    spdlog::trace("Destructing {}", typeid(*this).name());
+
+    uint64_t last_value = 0;
+    for (const auto& frame : frames_)
+        last_value = std::max(last_value, frame.timeline_value);
+
+    // Submissions still using scratch memory have to finish before it goes away
+    if (last_value != 0) {
+        auto wait_info = vk::SemaphoreWaitInfo()
+            .setSemaphores(timeline_semaphore_)
+            .setValues(last_value);
+        (void)device_.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+    }
+
+    for (auto& frame : frames_) {
+        vmaClearVirtualBlock(frame.block);
+        vmaDestroyVirtualBlock(frame.block);
+    }
+
+    allocator_.get().destroy_buffer(buffer_);
+}
+
+vk::DeviceSize scratch_arena::allocate_bytes(vk::DeviceSize size, vk::DeviceSize alignment) {
+    auto& frame = frames_[current_frame_];
+
+    VmaVirtualAllocationCreateInfo allocation_info {
+        .size = std::max<vk::DeviceSize>(size, 1),
+        .alignment = std::max(alignment, MIN_ALIGNMENT)
+    };
+
+    VmaVirtualAllocation allocation;
+    vk::DeviceSize offset;
+    if (vmaVirtualAllocate(frame.block, &allocation_info, &allocation, &offset) != VK_SUCCESS)
+        throw detailed_exception("Scratch allocation of {} bytes exceeds the frame capacity of {} bytes", size, frame_capacity_);
+
+    return frame.offset + offset;
+}
+
+void scratch_arena::retire(uint64_t timeline_value) {
+    frames_[current_frame_].timeline_value = timeline_value;
+    current_frame_ = (current_frame_ + 1) % frames_.size();
+
+    auto& frame = frames_[current_frame_];
+    if (frame.timeline_value != 0) {
+        auto wait_info = vk::SemaphoreWaitInfo()
+            .setSemaphores(timeline_semaphore_)
+            .setValues(frame.timeline_value);
+        (void)device_.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+    }
+
+    vmaClearVirtualBlock(frame.block);
+    frame.timeline_value = 0;
+}
+
+vk::DeviceSize scratch_arena::frame_capacity() const noexcept {
+    return frame_capacity_;
+}
+
+}
@@ -0,0 +1,25 @@
+#include <shader_bundle.hpp>
+#include <utility/hash.hpp>
+#include <algorithm>
+
+namespace vkengine {
+
+const embedded_shader_module* find_embedded_shader_module(std::string_view name) {
+    auto modules = embedded_shader_modules();
+    auto it = std::ranges::find(modules, name, &embedded_shader_module::name);
+    return it != modules.end() ? &*it : nullptr;
+}
+
+uint64_t embedded_shader_bundle_hash() {
+    static const uint64_t hash = [] {
+        uint64_t bundle_hash = FNV1A_64_OFFSET_BASIS;
+        for (const auto& module : embedded_shader_modules()) {
+            bundle_hash = fnv1a_64(module.name, bundle_hash);
+            bundle_hash = fnv1a_64(std::string_view(reinterpret_cast<const char*>(module.ir), module.ir_size), bundle_hash);
+        }
+        return bundle_hash;
+    }();
+    return hash;
+}
+
+}
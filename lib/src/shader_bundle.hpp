@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace vkengine {
+
+// A Slang module serialised to IR at build time, see VKENGINE_EMBED_SHADERS
+struct embedded_shader_module {
+    std::string_view        name;
+    const unsigned char*    ir;
+    size_t                  ir_size;
+};
+
+// Modules in the order they have to be loaded, imported modules first.
+// Empty when the library is built without embedded shaders.
+std::span<const embedded_shader_module> embedded_shader_modules();
+
+[[nodiscard]]
+const embedded_shader_module* find_embedded_shader_module(std::string_view name);
+
+// Identifies the bundle contents in cache keys, in place of hashing the sources on disk
+[[nodiscard]]
+uint64_t embedded_shader_bundle_hash();
+
+}
@@ -0,0 +1,9 @@
+#include <shader_bundle.hpp>
+
+namespace vkengine {
+
+std::span<const embedded_shader_module> embedded_shader_modules() {
+    return {};
+}
+
+}
@@ -0,0 +1,368 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_cache.hpp>
+#include <utility/hash.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+using namespace vkengine;
+
+// Bump whenever the layout of an entry changes, old entries are then treated as misses
+constexpr uint32_t SHADER_CACHE_MAGIC = 0x43505356; // "VSPC"
+constexpr uint32_t SHADER_BINARY_CACHE_MAGIC = 0x43425356; // "VSBC"
+constexpr uint32_t SHADER_CACHE_VERSION = 2;
+
+class binary_writer {
+public:
+    explicit binary_writer(std::ofstream& out) : out_(out) {}
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void write(const T& value) {
+        out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void write(const std::string& value) {
+        write(static_cast<uint64_t>(value.size()));
+        out_.write(value.data(), value.size());
+    }
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void write(const std::vector<T>& values) {
+        write(static_cast<uint64_t>(values.size()));
+        out_.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void write(const std::vector<vk::DescriptorSetLayoutBinding>& bindings) {
+        write(static_cast<uint64_t>(bindings.size()));
+        for (const auto& binding : bindings) {
+            write(binding.binding);
+            write(binding.descriptorType);
+            write(binding.descriptorCount);
+            write(binding.stageFlags);
+        }
+    }
+
+    void write(const std::vector<descriptor_set_info>& descriptor_sets) {
+        write(static_cast<uint64_t>(descriptor_sets.size()));
+        for (const auto& descriptor_set : descriptor_sets)
+            write(descriptor_set.bindings);
+    }
+
+private:
+    std::ofstream& out_;
+};
+
+class binary_reader {
+public:
+    explicit binary_reader(std::ifstream& in) : in_(in) {}
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void read(T& value) {
+        in_.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    void read(std::string& value) {
+        value.resize(read_count());
+        in_.read(value.data(), value.size());
+    }
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void read(std::vector<T>& values) {
+        values.resize(read_count());
+        in_.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void read(std::vector<vk::DescriptorSetLayoutBinding>& bindings) {
+        bindings.resize(read_count());
+        for (auto& binding : bindings) {
+            read(binding.binding);
+            read(binding.descriptorType);
+            read(binding.descriptorCount);
+            read(binding.stageFlags);
+        }
+    }
+
+    void read(std::vector<descriptor_set_info>& descriptor_sets) {
+        descriptor_sets.resize(read_count());
+        for (auto& descriptor_set : descriptor_sets)
+            read(descriptor_set.bindings);
+    }
+
+    bool good() const { return in_.good(); }
+
+private:
+    // Guards against allocating absurd sizes from a truncated or corrupt entry
+    size_t read_count() {
+        constexpr uint64_t max_count = 1ull << 28;
+
+        uint64_t count = 0;
+        read(count);
+        if (!in_ || count > max_count) {
+            in_.setstate(std::ios::failbit);
+            return 0;
+        }
+        return static_cast<size_t>(count);
+    }
+
+    std::ifstream& in_;
+};
+
+// Writes to a temporary and renames it into place so a concurrent reader never sees a partial entry
+template<typename F>
+void write_entry_atomically(const std::filesystem::path& path, F&& write_contents) {
+    auto temp_path = path;
+    temp_path += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        binary_writer writer(out);
+        write_contents(writer);
+
+        if (!out) {
+            spdlog::warn("Failed to write shader cache entry {}", temp_path.string());
+            std::error_code error;
+            std::filesystem::remove(temp_path, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        spdlog::warn("Failed to commit shader cache entry {}: {}", path.string(), error.message());
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+std::filesystem::path create_cache_directory(std::filesystem::path directory) {
+    if (directory.empty())
+        return directory;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        spdlog::warn("Disabling shader cache, failed to create {}: {}", directory.string(), error.message());
+        return {};
+    }
+    return directory;
+}
+
+}
+
+namespace vkengine {
+
+shader_cache::shader_cache(std::filesystem::path directory)
+    : directory_(create_cache_directory(std::move(directory))) {}
+
+std::optional<cached_program> shader_cache::load(const std::string& key) {
+    if (!enabled()) {
+        misses_++;
+        return std::nullopt;
+    }
+
+    auto path = entry_path(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        spdlog::debug("Shader cache miss: {}", path.filename().string());
+        misses_++;
+        return std::nullopt;
+    }
+
+    binary_reader reader(in);
+
+    uint32_t magic = 0, version = 0;
+    std::string stored_key;
+    reader.read(magic);
+    reader.read(version);
+    reader.read(stored_key);
+
+    if (!reader.good() || magic != SHADER_CACHE_MAGIC || version != SHADER_CACHE_VERSION || stored_key != key) {
+        spdlog::debug("Shader cache entry {} is stale, ignoring it", path.filename().string());
+        misses_++;
+        return std::nullopt;
+    }
+
+    cached_program program;
+    auto& root_layout = program.root_layout;
+
+    reader.read(root_layout.global.push_constant_ranges);
+    reader.read(root_layout.global.descriptor_set_infos);
+
+    constexpr uint64_t max_entry_point_count = 1024;
+
+    uint64_t entry_point_count = 0;
+    reader.read(entry_point_count);
+    root_layout.entry_points.resize(reader.good() && entry_point_count <= max_entry_point_count ? entry_point_count : 0);
+
+    for (auto& entry_point : root_layout.entry_points) {
+        reader.read(entry_point.name);
+        reader.read(entry_point.push_constant_ranges);
+        reader.read(entry_point.descriptor_set_infos);
+        reader.read(entry_point.shader_stage);
+        reader.read(entry_point.offset.binding);
+        reader.read(entry_point.offset.binding_set);
+        reader.read(entry_point.offset.push_constant_range_offset);
+    }
+
+    program.entry_point_spirv.resize(root_layout.entry_points.size());
+    for (auto& spirv : program.entry_point_spirv)
+        reader.read(spirv);
+
+    if (!reader.good() || root_layout.entry_points.empty()) {
+        spdlog::warn("Shader cache entry {} is truncated, ignoring it", path.filename().string());
+        misses_++;
+        return std::nullopt;
+    }
+
+    spdlog::debug("Shader cache hit: {}", path.filename().string());
+    hits_++;
+    return program;
+}
+
+void shader_cache::store(const std::string& key, const cached_program& program) {
+    if (!enabled())
+        return;
+
+    write_entry_atomically(entry_path(key), [&](binary_writer& writer) {
+        const auto& root_layout = program.root_layout;
+
+        writer.write(SHADER_CACHE_MAGIC);
+        writer.write(SHADER_CACHE_VERSION);
+        writer.write(key);
+
+        writer.write(root_layout.global.push_constant_ranges);
+        writer.write(root_layout.global.descriptor_set_infos);
+
+        writer.write(static_cast<uint64_t>(root_layout.entry_points.size()));
+        for (const auto& entry_point : root_layout.entry_points) {
+            writer.write(entry_point.name);
+            writer.write(entry_point.push_constant_ranges);
+            writer.write(entry_point.descriptor_set_infos);
+            writer.write(entry_point.shader_stage);
+            writer.write(entry_point.offset.binding);
+            writer.write(entry_point.offset.binding_set);
+            writer.write(entry_point.offset.push_constant_range_offset);
+        }
+
+        for (const auto& spirv : program.entry_point_spirv)
+            writer.write(spirv);
+    });
+}
+
+bool shader_cache::enabled() const noexcept {
+    return !directory_.empty();
+}
+
+shader_cache::statistics shader_cache::stats() const noexcept {
+    return statistics {
+        .hits = hits_.load(),
+        .misses = misses_.load()
+    };
+}
+
+const std::filesystem::path& shader_cache::directory() const noexcept {
+    return directory_;
+}
+
+std::filesystem::path shader_cache::entry_path(const std::string& key) const {
+    return directory_ / fmt::format("{:016x}.spvcache", fnv1a_64(key));
+}
+
+shader_binary_cache::shader_binary_cache(std::filesystem::path directory, const gpu& gpu)
+    : directory_(create_cache_directory(std::move(directory))),
+    device_key_(fmt::format(
+        "device {:02x}\ndriver {:02x} {}\nbinary {:02x} {}\n",
+        fmt::join(gpu.id_properties.deviceUUID, ""),
+        fmt::join(gpu.id_properties.driverUUID, ""),
+        gpu.properties.properties.driverVersion,
+        fmt::join(gpu.shader_object_properties.shaderBinaryUUID, ""),
+        gpu.shader_object_properties.shaderBinaryVersion)) {}
+
+std::optional<std::vector<std::vector<uint8_t>>> shader_binary_cache::load(const std::string& program_key) {
+    std::string key = device_key_ + program_key;
+
+    if (!enabled()) {
+        misses_++;
+        return std::nullopt;
+    }
+
+    auto path = entry_path(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        misses_++;
+        return std::nullopt;
+    }
+
+    binary_reader reader(in);
+
+    uint32_t magic = 0, version = 0;
+    std::string stored_key;
+    reader.read(magic);
+    reader.read(version);
+    reader.read(stored_key);
+
+    if (!reader.good() || magic != SHADER_BINARY_CACHE_MAGIC || version != SHADER_CACHE_VERSION || stored_key != key) {
+        misses_++;
+        return std::nullopt;
+    }
+
+    constexpr uint64_t max_entry_point_count = 1024;
+
+    uint64_t binary_count = 0;
+    reader.read(binary_count);
+
+    std::vector<std::vector<uint8_t>> binaries(reader.good() && binary_count <= max_entry_point_count ? binary_count : 0);
+    for (auto& binary : binaries)
+        reader.read(binary);
+
+    if (!reader.good() || binaries.empty()) {
+        spdlog::warn("Shader binary cache entry {} is truncated, ignoring it", path.filename().string());
+        misses_++;
+        return std::nullopt;
+    }
+
+    hits_++;
+    return binaries;
+}
+
+void shader_binary_cache::store(const std::string& program_key, const std::vector<std::vector<uint8_t>>& binaries) {
+    if (!enabled())
+        return;
+
+    std::string key = device_key_ + program_key;
+
+    write_entry_atomically(entry_path(key), [&](binary_writer& writer) {
+        writer.write(SHADER_BINARY_CACHE_MAGIC);
+        writer.write(SHADER_CACHE_VERSION);
+        writer.write(key);
+
+        writer.write(static_cast<uint64_t>(binaries.size()));
+        for (const auto& binary : binaries)
+            writer.write(binary);
+    });
+}
+
+void shader_binary_cache::report_incompatible() noexcept {
+    incompatible_++;
+}
+
+bool shader_binary_cache::enabled() const noexcept {
+    return !directory_.empty();
+}
+
+shader_binary_cache::statistics shader_binary_cache::stats() const noexcept {
+    return statistics {
+        .hits = hits_.load(),
+        .misses = misses_.load(),
+        .incompatible = incompatible_.load()
+    };
+}
+
+std::filesystem::path shader_binary_cache::entry_path(const std::string& key) const {
+    return directory_ / fmt::format("{:016x}.shaderbin", fnv1a_64(key));
+}
+
+}
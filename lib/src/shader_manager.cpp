@@ -1,29 +1,129 @@
 ﻿#include <vulkan/vulkan.hpp>
 #include <shader_manager.hpp>
 #include <shader_layout.hpp>
+#include <shader_source_watcher.hpp>
+#include <shader_bundle.hpp>
+#include <slang_helpers.hpp>
 #include <spdlog/spdlog.h>
 #include <detailed_exception.hpp>
 #include <spdlog/fmt/ranges.h>
+#include <utility/hash.hpp>
+#include <algorithm>
+#include <chrono>
 #include <ranges>
 #include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
 
+namespace {
+
+constexpr const char* SHADER_TARGET_PROFILE = "spirv_1_6";
+
+std::string read_text_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw vkengine::detailed_exception("Failed to read shader source: {}", path.string());
+
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Mirrors how load_shader names modules: either a path to a .slang file or a module name in VKENGINE_SHADER_DIR
+std::filesystem::path resolve_module_path(const std::string& module_name) {
+    std::filesystem::path path(module_name);
+    if (path.extension() != ".slang")
+        path += ".slang";
+    if (path.is_relative())
+        path = std::filesystem::path(VKENGINE_SHADER_DIR) / path;
+    return path.lexically_normal();
+}
+
+// Slang resolves 'import a.b;' to 'a/b.slang', first next to the importing file and then on the search paths
+std::filesystem::path resolve_import_path(const std::filesystem::path& importing_file, std::string import_name) {
+    std::ranges::replace(import_name, '.', '/');
+    std::filesystem::path relative_path = import_name + ".slang";
+
+    if (auto sibling = importing_file.parent_path() / relative_path; std::filesystem::exists(sibling))
+        return sibling.lexically_normal();
+    return (std::filesystem::path(VKENGINE_SHADER_DIR) / relative_path).lexically_normal();
+}
+
+// The blobs have to stay valid for as long as any session uses the modules loaded from them
+static_blob& embedded_module_blob(const vkengine::embedded_shader_module& module) {
+    static std::vector<static_blob> blobs = vkengine::embedded_shader_modules()
+        | std::views::transform([](const auto& embedded) { return static_blob(embedded.ir, embedded.ir_size); })
+        | std::ranges::to<std::vector>();
+
+    return blobs[&module - vkengine::embedded_shader_modules().data()];
+}
+
+// Programs built from the shader directory use the precompiled module of the same name when there is one
+const vkengine::embedded_shader_module* find_embedded_module(const std::string& module_name) {
+    auto path = resolve_module_path(module_name);
+    if (path.parent_path() != std::filesystem::path(VKENGINE_SHADER_DIR).lexically_normal())
+        return nullptr;
+    return vkengine::find_embedded_shader_module(path.stem().string());
+}
+
+// Appends the content hash of 'path' and, recursively, of every module it imports to 'key'.
+// This is a textual scan rather than a Slang front end pass, so a cache lookup never has to parse anything.
+void append_source_hashes(const std::filesystem::path& path, std::set<std::filesystem::path>& visited, std::string& key) {
+    if (!visited.insert(path).second)
+        return;
+
+    if (!std::filesystem::exists(path)) {
+        key += fmt::format("source {} missing\n", path.generic_string());
+        return;
+    }
+
+    std::string source = read_text_file(path);
+    key += fmt::format("source {} {:016x}\n", path.generic_string(), vkengine::fnv1a_64(source));
+
+    static const std::regex import_regex(R"(^\s*(?:__exported\s+)?import\s+([A-Za-z0-9_.]+)\s*;)");
+
+    std::istringstream lines(source);
+    for (std::string line; std::getline(lines, line);) {
+        std::smatch match;
+        if (std::regex_search(line, match, import_regex))
+            append_source_hashes(resolve_import_path(path, match[1].str()), visited, key);
+    }
+}
+
+}
 
 namespace vkengine {
 
-shader_manager::shader_manager(std::reference_wrapper<vulkan_core> vulkan_core)
-    : vulkan(vulkan_core) {
-    setup_slang_session();
-    create_subgroup_module();
+shader_manager::shader_manager(
+    std::reference_wrapper<vulkan_core> vulkan_core,
+    std::filesystem::path cache_directory,
+    uint32_t compile_worker_count
+)
+    : vulkan(vulkan_core),
+    limits(vulkan_core.get().gpu().properties.properties.limits),
+    subgroup_module_source(fmt::format("export static const uint SUBGROUP_SIZE = {};", vulkan_core.get().gpu().subgroup_properties.subgroupSize)),
+    program_cache(std::move(cache_directory)),
+    binary_cache(program_cache.enabled() ? program_cache.directory() / "driver" : std::filesystem::path(), vulkan_core.get().gpu()),
+    layouts(std::make_shared<layout_cache>(vulkan_core.get().device())),
+    tuning(program_cache.enabled() ? program_cache.directory() / "tuning" : std::filesystem::path(), vulkan_core.get().gpu()),
+    main_context(create_compile_context()),
+    worker_contexts(compile_worker_count),
+    compile_pool(compile_worker_count) {
+    slang_build_tag = main_context.global_session->getBuildTagString();
 }
 
+shader_manager::~shader_manager() = default;
+
 void shader_manager::throw_exception_with_slang_diagnostics(
+    const compile_context& context,
     const std::string& base_message,
     const std::source_location& location
 ) {
     std::string full_message = base_message;
 
-    if (diagnostics != nullptr)
-        if (const char* diagnostic_msg = static_cast<const char*>(diagnostics->getBufferPointer()))
+    if (context.diagnostics != nullptr)
+        if (const char* diagnostic_msg = static_cast<const char*>(context.diagnostics->getBufferPointer()))
             if (strlen(diagnostic_msg) > 0)
                 full_message += fmt::format("\nSlang diagnostics:\n{}", diagnostic_msg);
 
@@ -33,6 +133,15 @@ void shader_manager::throw_exception_with_slang_diagnostics(
 Slang::ComPtr<slang::IModule> shader_manager::create_shader_module_from_source_string(
     const std::string& source_string,
     const std::string& module_name
+) {
+    std::lock_guard lock(main_context_mutex);
+    return create_module_from_source(current(main_context), source_string, module_name);
+}
+
+Slang::ComPtr<slang::IModule> shader_manager::create_module_from_source(
+    compile_context& context,
+    const std::string& source_string,
+    const std::string& module_name
 ) {
 	spdlog::info("Creating shader module from source string: {}", module_name);
 	spdlog::debug("Source string: {}", source_string);
@@ -40,41 +149,323 @@ Slang::ComPtr<slang::IModule> shader_manager::create_shader_module_from_source_s
     std::string module_path = fmt::format("{}.slang", module_name);
 
 	Slang::ComPtr<slang::IModule> module(
-        session->loadModuleFromSourceString(
+        context.session->loadModuleFromSourceString(
 		module_name.c_str(),
         module_path.c_str(),
 		source_string.c_str(),
-		diagnostics.writeRef())
+		context.diagnostics.writeRef())
     );
 
 	if (!module)
-		throw detailed_exception("Failed to create shader module from source string");
+		throw_exception_with_slang_diagnostics(context, "Failed to create shader module from source string");
 
 	return module;
 }
 
-shader_program shader_manager::load_shader(
+shader_program_handle shader_manager::load_shader(
     const std::string& module_name,
     const std::vector<entry_point_compile_info>& entry_point_infos,
-    const std::vector<Slang::ComPtr<slang::IModule>> modules
+    const std::vector<source_module>& modules
 ) {
-    spdlog::info("Loading shader: {}", module_name);
+    return load_shader(program_compile_info {
+        .module_name = module_name,
+        .entry_points = entry_point_infos,
+        .modules = modules
+    });
+}
+
+shader_program_handle shader_manager::load_shader(const program_compile_info& program_info) {
+    std::string program_key = loaded_program_key(program_info);
+
+    std::promise<shader_program_handle> promise;
+    std::shared_future<shader_program_handle> loaded;
+    {
+        std::lock_guard lock(loaded_programs_mutex);
+        if (auto it = loaded_programs.find(program_key); it != loaded_programs.end())
+            loaded = it->second;
+        else
+            loaded_programs.emplace(program_key, promise.get_future().share());
+    }
+
+    // Waiting happens outside the lock, a failing background compile takes it to forget the program
+    if (loaded.valid())
+        return loaded.get();
+
+    try {
+        std::lock_guard lock(main_context_mutex);
+        auto handle = build_program(current(main_context), program_info);
+        promise.set_value(handle);
+        return handle;
+    } catch (...) {
+        forget_program(program_key);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+std::shared_future<shader_program_handle> shader_manager::load_shader_async(const program_compile_info& program_info) {
+    std::string program_key = loaded_program_key(program_info);
+
+    std::promise<shader_program_handle> promise;
+    std::shared_future<shader_program_handle> future;
+    {
+        std::lock_guard lock(loaded_programs_mutex);
+        if (auto it = loaded_programs.find(program_key); it != loaded_programs.end())
+            return it->second;
+
+        future = promise.get_future().share();
+        loaded_programs.emplace(program_key, future);
+    }
+
+    compile_pool.submit(
+        [this, program_info, program_key = std::move(program_key), promise = std::move(promise)](uint32_t worker_index) mutable {
+            try {
+                promise.set_value(build_program(worker_context(worker_index), program_info));
+            } catch (...) {
+                forget_program(program_key);
+                promise.set_exception(std::current_exception());
+            }
+        });
+
+    return future;
+}
+
+std::vector<std::shared_future<shader_program_handle>> shader_manager::warm_up(const std::vector<program_compile_info>& program_infos) {
+    spdlog::info("Warming up {} shader programs on {} workers", program_infos.size(), compile_pool.size());
+
+    return program_infos
+        | std::views::transform([&](const program_compile_info& program_info) { return load_shader_async(program_info); })
+        | std::ranges::to<std::vector>();
+}
+
+shader_cache::statistics shader_manager::cache_statistics() const {
+    return program_cache.stats();
+}
+
+shader_binary_cache::statistics shader_manager::binary_cache_statistics() const {
+    return binary_cache.stats();
+}
+
+layout_cache::statistics shader_manager::layout_statistics() const {
+    return layouts->stats();
+}
+
+const vk::PhysicalDeviceLimits& shader_manager::device_limits() const noexcept {
+    return limits;
+}
+
+const gpu& shader_manager::gpu() const noexcept {
+    return vulkan.get().gpu();
+}
+
+uint64_t shader_manager::program_generation() const noexcept {
+    return swapped_generation;
+}
+
+workgroup_tuning& shader_manager::workgroup_sizes() noexcept {
+    return tuning;
+}
+
+void shader_manager::enable_hot_reload(uint32_t frames_in_flight) {
+    if (source_watcher)
+        return;
+
+    // The embedded modules would shadow edited files, so sessions are recreated to read them from disk instead
+    hot_reload_enabled = true;
+    source_generation++;
+
+    // Programs built from embedded modules never looked at their files, find them now so that edits reach them
+    {
+        std::lock_guard lock(loaded_programs_mutex);
+        for (auto& [program_key, sources] : loaded_sources)
+            if (sources.files.empty())
+                program_cache_key(sources.compile_info, sources.files);
+    }
+
+    reload_frames_in_flight = frames_in_flight;
+    source_watcher = std::make_unique<shader_source_watcher>(
+        VKENGINE_SHADER_DIR,
+        [this](const std::set<std::filesystem::path>& changed_files) { on_sources_changed(changed_files); });
+}
+
+void shader_manager::on_sources_changed(const std::set<std::filesystem::path>& changed_files) {
+    source_generation++;
+
+    std::vector<std::pair<std::string, loaded_program_sources>> affected_programs;
+    {
+        std::lock_guard lock(loaded_programs_mutex);
+        for (auto& [program_key, sources] : loaded_sources) {
+            bool affected = std::ranges::any_of(changed_files, [&](const std::filesystem::path& file) { return sources.files.contains(file); });
+            if (affected) {
+                sources.reload_generation++;
+                affected_programs.emplace_back(program_key, sources);
+            }
+        }
+    }
+
+    spdlog::info("Shader sources changed ({}), recompiling {} programs",
+        fmt::join(changed_files | std::views::transform([](const auto& file) { return file.filename().string(); }), ", "),
+        affected_programs.size());
+
+    for (auto& [program_key, sources] : affected_programs)
+        compile_pool.submit([this, program_key, sources](uint32_t worker_index) {
+            shader_program_handle program;
+            try {
+                program = build_program(worker_context(worker_index), sources.compile_info);
+            } catch (const std::exception& e) {
+                spdlog::error("Failed to reload {}, keeping the previous version: {}", sources.compile_info.module_name, e.what());
+                return;
+            }
+
+            // A newer change may have been saved while this one was compiling. Both locks are taken together, as in
+            // swap_reloaded_programs(), so neither path can hold one while waiting for the other.
+            std::scoped_lock locks(loaded_programs_mutex, reload_mutex);
+            if (auto it = loaded_sources.find(program_key); it == loaded_sources.end() || it->second.reload_generation != sources.reload_generation)
+                return;
+
+            reloaded_programs[program_key] = std::move(program);
+        });
+}
+
+uint32_t shader_manager::swap_reloaded_programs() {
+    // Locked together with the reload tasks' std::scoped_lock, the programs lock is released once they are swapped
+    std::unique_lock reload_lock(reload_mutex, std::defer_lock);
+    std::unique_lock lock(loaded_programs_mutex, std::defer_lock);
+    std::lock(reload_lock, lock);
+
+    std::vector<shader_program_handle> retired;
+    for (auto& [program_key, program] : reloaded_programs) {
+        auto it = loaded_programs.find(program_key);
+        if (it == loaded_programs.end())
+            continue;
+
+        if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            retired.push_back(it->second.get());
+
+        std::promise<shader_program_handle> promise;
+        promise.set_value(std::move(program));
+        it->second = promise.get_future().share();
+    }
+    lock.unlock();
+
+    auto swapped_count = static_cast<uint32_t>(reloaded_programs.size());
+    if (swapped_count > 0) {
+        spdlog::info("Swapped in {} reloaded shader programs", swapped_count);
+        swapped_generation++;
+    }
+
+    reloaded_programs.clear();
+    retired_programs.push_back(std::move(retired));
+    while (retired_programs.size() > reload_frames_in_flight)
+        retired_programs.pop_front();
+
+    return swapped_count;
+}
+
+// Unlike the on-disk key this does not look at the module sources on disk, so a lookup costs one string hash
+std::string shader_manager::loaded_program_key(const program_compile_info& program_info) {
+    std::string key = program_info.module_name;
+
+    for (const auto& entry_point_info : program_info.entry_points)
+        key += fmt::format("\n{}<{}>", entry_point_info.name, fmt::join(entry_point_info.specialisation_type_names, ","));
+
+    for (const auto& module : program_info.modules)
+        key += fmt::format("\n{}\n{}", module.name, module.source);
+
+    return key;
+}
+
+// 'source_files' receives every file the program was built from, which is what hot reload watches for
+std::string shader_manager::program_cache_key(const program_compile_info& program_info, std::set<std::filesystem::path>& source_files) const {
+    std::string key = fmt::format("slang {}\ntarget {}\n", slang_build_tag, SHADER_TARGET_PROFILE);
+
+    if (use_embedded_modules() && find_embedded_module(program_info.module_name))
+        key += fmt::format("bundle {:016x}\n", embedded_shader_bundle_hash());
+    else
+        append_source_hashes(resolve_module_path(program_info.module_name), source_files, key);
 
-    Slang::ComPtr<slang::IModule> module(session->loadModule(module_name.c_str(), diagnostics.writeRef()));
+    for (const auto& entry_point_info : program_info.entry_points)
+        key += fmt::format("entry {} <{}>\n", entry_point_info.name, fmt::join(entry_point_info.specialisation_type_names, ","));
+
+    for (const auto& module : program_info.modules)
+        key += fmt::format("module {} {:016x}\n", module.name, fnv1a_64(module.source));
+
+    key += fmt::format("module subgroup_size {:016x}\n", fnv1a_64(subgroup_module_source));
+
+    return key;
+}
+
+// A failed compilation is not remembered so that a later request tries again
+void shader_manager::forget_program(const std::string& program_key) {
+    std::lock_guard lock(loaded_programs_mutex);
+    loaded_programs.erase(program_key);
+    loaded_sources.erase(program_key);
+}
+
+shader_program_handle shader_manager::build_program(compile_context& context, const program_compile_info& program_info) {
+    spdlog::info("Loading shader: {}", program_info.module_name);
+
+    std::set<std::filesystem::path> source_files;
+    std::string cache_key = program_cache_key(program_info, source_files);
+
+    cached_program program;
+    if (auto cached = program_cache.load(cache_key)) {
+        program = std::move(*cached);
+    } else {
+        program = compile_program(context, program_info);
+        program_cache.store(cache_key, program);
+    }
+
+    acquire_descriptor_set_layouts(program.root_layout);
+
+    shader_program_handle handle;
+    try {
+        handle = shader_program_handle(
+            new shader_program(create_shader_objects(program, cache_key)),
+            [device = vulkan.get().device(), layouts = layouts](const shader_program* program) {
+                destroy_shader_program(device, *layouts, *program);
+                delete program;
+            });
+    } catch (...) {
+        release_descriptor_set_layouts(*layouts, program.root_layout);
+        throw;
+    }
+
+    {
+        std::lock_guard lock(loaded_programs_mutex);
+        auto& sources = loaded_sources[loaded_program_key(program_info)];
+        sources.compile_info = program_info;
+        sources.files = std::move(source_files);
+    }
+
+    return handle;
+}
+
+cached_program shader_manager::compile_program(compile_context& context, const program_compile_info& program_info) {
+    spdlog::info("Compiling shader: {}", program_info.module_name);
+
+    auto& session = context.session;
+    auto& diagnostics = context.diagnostics;
+
+    Slang::ComPtr<slang::IModule> module;
+    if (auto embedded = find_embedded_module(program_info.module_name); embedded && context.embedded_modules.contains(embedded->name))
+        module = context.embedded_modules.at(embedded->name);
+    else
+        module = session->loadModule(program_info.module_name.c_str(), diagnostics.writeRef());
 
     if (!module)
-        throw_exception_with_slang_diagnostics("Failed to create module");
+        throw_exception_with_slang_diagnostics(context, "Failed to create module");
 
 	auto module_layout = module->getLayout();
 
-    auto entry_points = entry_point_infos
+    auto entry_points = program_info.entry_points
         | std::views::transform(
             [&](const entry_point_compile_info& entry_point_info) {
                 Slang::ComPtr<slang::IComponentType> entry_point;
                 module->findEntryPointByName(entry_point_info.name.c_str(), reinterpret_cast<slang::IEntryPoint**>(entry_point.writeRef()));
 
                 if (!entry_point)
-                    throw_exception_with_slang_diagnostics("Failed to find entry point: " + entry_point_info.name);
+                    throw_exception_with_slang_diagnostics(context, "Failed to find entry point: " + entry_point_info.name);
 
                 if (!entry_point_info.specialisation_type_names.empty()) {
                     Slang::ComPtr<slang::IComponentType> specialised_entry_point;
@@ -95,7 +486,7 @@ shader_program shader_manager::load_shader(
 					);
 
 					if (!specialised_entry_point)
-						throw_exception_with_slang_diagnostics("Failed to specialise entry point: " + entry_point_info.name);
+						throw_exception_with_slang_diagnostics(context, "Failed to specialise entry point: " + entry_point_info.name);
 
 					entry_point = specialised_entry_point.get();
                 }
@@ -103,98 +494,238 @@ shader_program shader_manager::load_shader(
             })
         | std::ranges::to<std::vector>();
 
-    std::vector<slang::IComponentType*> components = { module, subgroup_module };
+    // Injected modules are named after their source so that programs with different constants never alias
+    auto injected_modules = program_info.modules
+        | std::views::transform([&](const source_module& source) {
+            std::string unique_name = fmt::format("{}_{:016x}", source.name, fnv1a_64(source.source));
+            return create_module_from_source(context, source.source, unique_name);
+        })
+        | std::ranges::to<std::vector>();
+
+    std::vector<slang::IComponentType*> components = { module, context.subgroup_module };
 	components.insert(components.end(), entry_points.begin(), entry_points.end());
-	components.insert(components.end(), modules.begin(), modules.end());
+	components.insert(components.end(), injected_modules.begin(), injected_modules.end());
 
     Slang::ComPtr<slang::IComponentType> program = nullptr;
     session->createCompositeComponentType(components.data(), components.size(), program.writeRef(), diagnostics.writeRef());
 
     if (!program)
-        throw_exception_with_slang_diagnostics("Failed to create slang program");
+        throw_exception_with_slang_diagnostics(context, "Failed to create slang program");
 
     Slang::ComPtr<slang::IComponentType> linked_program;
 	program->link(linked_program.writeRef(), diagnostics.writeRef());
 
 	if (!linked_program)
-		throw_exception_with_slang_diagnostics("Failed to link program");
-
-    slang::ProgramLayout* layout = linked_program->getLayout();
-
-    vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eCompute;
-
-    Slang::ComPtr<slang::IBlob> spirv_code;
-    linked_program->getTargetCode(0, spirv_code.writeRef(), diagnostics.writeRef());
-
-    if (!spirv_code)
-        throw_exception_with_slang_diagnostics("Failed to create spirv code");
+		throw_exception_with_slang_diagnostics(context, "Failed to link program");
 
 	slang::ProgramLayout* program_layout = linked_program->getLayout();
 
     auto entry_point_count = program_layout->getEntryPointCount();
     root_shader_layout_builder builder;
 
-    builder.add_global_params(program_layout->getGlobalParamsVarLayout(), vulkan);
+    builder.add_global_params(program_layout->getGlobalParamsVarLayout());
     for (uint32_t idx : std::views::iota(0u) | std::views::take(entry_point_count))
-        builder.add_entry_point(program_layout->getEntryPointByIndex(idx), vulkan);
+        builder.add_entry_point(program_layout->getEntryPointByIndex(idx));
 
-    root_shader_object_layout root_layout = builder.build();
-
-    auto shader_objects = std::views::iota(0u, entry_point_count) | std::views::transform([&](uint32_t idx) {
+    // Each shader object only gets the code reachable from its own entry point, rather than the whole
+    // module, so the driver does not compile every entry point once per shader object
+    auto entry_point_spirv = std::views::iota(0u, static_cast<uint32_t>(entry_point_count)) | std::views::transform([&](uint32_t idx) {
         Slang::ComPtr<slang::IBlob> entry_point_code;
-        linked_program->getEntryPointCode(
-            idx, 0,
-            entry_point_code.writeRef(),
-            diagnostics.writeRef());
+        linked_program->getEntryPointCode(idx, 0, entry_point_code.writeRef(), diagnostics.writeRef());
 
         if (!entry_point_code)
-            throw_exception_with_slang_diagnostics("Failed to create entry point code");
-
-        auto set_layouts = root_layout.entry_point_descriptor_sets(idx) | std::ranges::to<std::vector<vk::DescriptorSetLayout>>();
-        auto& push_constants = root_layout.entry_push_constants(idx);
-
-        auto pipeline_layout = vulkan.get().device()
-            .createPipelineLayout(
-                vk::PipelineLayoutCreateInfo{}
-                .setSetLayouts(set_layouts)
-                .setPushConstantRanges(push_constants)
-            );
-
-        auto shader_obj = vulkan.get().device()
-            .createShaderEXT(
-                vk::ShaderCreateInfoEXT{}
-                .setStage(stage)
-                .setCodeType(vk::ShaderCodeTypeEXT::eSpirv)
-                .setCodeSize(spirv_code->getBufferSize())
+            throw_exception_with_slang_diagnostics(context, "Failed to create entry point code");
+
+        const auto* spirv_words = static_cast<const uint32_t*>(entry_point_code->getBufferPointer());
+        return std::vector<uint32_t>(spirv_words, spirv_words + entry_point_code->getBufferSize() / sizeof(uint32_t));
+    }) | std::ranges::to<std::vector>();
+
+    if (spdlog::should_log(spdlog::level::debug)) {
+        Slang::ComPtr<slang::IBlob> program_code;
+        linked_program->getTargetCode(0, program_code.writeRef(), diagnostics.writeRef());
+
+        auto entry_point_bytes = entry_point_spirv | std::views::transform([](const auto& spirv) { return spirv.size() * sizeof(uint32_t); });
+        auto program_bytes = program_code ? program_code->getBufferSize() : 0;
+
+        spdlog::debug("{}: per entry point SPIR-V {} bytes, {} bytes in total, previously {} bytes per entry point",
+            program_info.module_name,
+            entry_point_bytes,
+            std::ranges::fold_left(entry_point_bytes, size_t(0), std::plus<>()),
+            program_bytes);
+    }
+
+    return cached_program {
+        .root_layout = builder.build(),
+        .entry_point_spirv = std::move(entry_point_spirv)
+    };
+}
+
+// Layouts come from this manager's layout cache, so its programs with the same interface share them
+void shader_manager::acquire_descriptor_set_layouts(root_shader_object_layout& root_layout) {
+    for (auto& descriptor_set : root_layout.global.descriptor_set_infos)
+        descriptor_set.descriptor_set_layout = layouts->acquire_descriptor_set_layout(descriptor_set.bindings);
+
+    for (auto& entry_point : root_layout.entry_points)
+        for (auto& descriptor_set : entry_point.descriptor_set_infos)
+            descriptor_set.descriptor_set_layout = layouts->acquire_descriptor_set_layout(descriptor_set.bindings);
+}
+
+void shader_manager::release_descriptor_set_layouts(layout_cache& layouts, const root_shader_object_layout& root_layout) {
+    for (const auto& descriptor_set : root_layout.global.descriptor_set_infos)
+        layouts.release_descriptor_set_layout(descriptor_set.descriptor_set_layout);
+
+    for (const auto& entry_point : root_layout.entry_points)
+        for (const auto& descriptor_set : entry_point.descriptor_set_infos)
+            layouts.release_descriptor_set_layout(descriptor_set.descriptor_set_layout);
+}
+
+// Shader objects are created from cached driver binaries when possible, skipping the driver's SPIR-V compile.
+// Any binary the driver rejects falls back to SPIR-V, and the binaries are then refreshed for the next run.
+// All shader objects of a program are created with a single vkCreateShadersEXT call per code type.
+shader_program shader_manager::create_shader_objects(const cached_program& program, const std::string& cache_key) {
+    auto start = std::chrono::steady_clock::now();
+
+    root_shader_object_layout root_layout = program.root_layout;
+    auto entry_point_count = static_cast<uint32_t>(root_layout.entry_points.size());
+    auto entry_point_indices = std::views::iota(0u, entry_point_count);
+    vk::Device device = vulkan.get().device();
+
+    auto binaries = binary_cache.load(cache_key);
+    if (binaries && binaries->size() != entry_point_count)
+        binaries.reset();
+
+    bool refresh_binaries = !binaries;
+
+    auto set_layouts = entry_point_indices
+        | std::views::transform([&](uint32_t idx) {
+            return root_layout.entry_point_descriptor_sets(idx) | std::ranges::to<std::vector<vk::DescriptorSetLayout>>();
+        })
+        | std::ranges::to<std::vector>();
+
+    auto shader_create_infos = entry_point_indices
+        | std::views::transform([&](uint32_t idx) {
+            return vk::ShaderCreateInfoEXT{}
+                .setStage(root_layout.entry_points[idx].shader_stage)
                 .setPName(root_layout.entry_points[idx].name.c_str())
-                .setPCode(static_cast<const uint32_t*>(spirv_code->getBufferPointer()))
-                .setPushConstantRanges(push_constants)
-                .setSetLayouts(set_layouts)
-            );
-
-        if (shader_obj.result != vk::Result::eSuccess)
-            throw detailed_exception("Failed to create shader object");
-
-        return shader_entry_point {
-            .pipeline_layout = pipeline_layout,
-            .push_constant_range = push_constants[0],
-            .shader_ext = shader_obj.value,
-            .stage = stage
-        };
-    });
+                .setPushConstantRanges(root_layout.entry_push_constants(idx))
+                .setSetLayouts(set_layouts[idx]);
+        })
+        | std::ranges::to<std::vector>();
+
+    std::vector<vk::ShaderEXT> shaders(entry_point_count);
+    std::vector<shader_entry_point> entry_points;
+    entry_points.reserve(entry_point_count);
+
+    // The shader objects and pipeline layouts are owned here until the program takes them. The pointer variant
+    // of createShadersEXT is used so that objects created before a failure are not lost to an exception.
+    try {
+        if (binaries) {
+            // vkCreateShadersEXT wants binary code 16 byte aligned, which operator new already guarantees
+            auto binary_create_infos = entry_point_indices
+                | std::views::transform([&](uint32_t idx) {
+                    return vk::ShaderCreateInfoEXT(shader_create_infos[idx])
+                        .setCodeType(vk::ShaderCodeTypeEXT::eBinary)
+                        .setCodeSize((*binaries)[idx].size())
+                        .setPCode((*binaries)[idx].data());
+                })
+                | std::ranges::to<std::vector>();
+
+            // Rejected binaries come back as null handles, the others are still created
+            auto result = device.createShadersEXT(entry_point_count, binary_create_infos.data(), nullptr, shaders.data());
+            if (result != vk::Result::eSuccess && result != vk::Result::eIncompatibleShaderBinaryEXT)
+                spdlog::debug("Shader binaries rejected: {}", vk::to_string(result));
+
+            if (std::ranges::any_of(shaders, [](vk::ShaderEXT shader) { return !shader; })) {
+                binary_cache.report_incompatible();
+                refresh_binaries = true;
+            }
+        }
+
+        auto spirv_indices = entry_point_indices
+            | std::views::filter([&](uint32_t idx) { return !shaders[idx]; })
+            | std::ranges::to<std::vector>();
+
+        if (!spirv_indices.empty()) {
+            auto spirv_create_infos = spirv_indices
+                | std::views::transform([&](uint32_t idx) {
+                    const auto& spirv = program.entry_point_spirv[idx];
+                    return vk::ShaderCreateInfoEXT(shader_create_infos[idx])
+                        .setCodeType(vk::ShaderCodeTypeEXT::eSpirv)
+                        .setCodeSize(spirv.size() * sizeof(uint32_t))
+                        .setPCode(spirv.data());
+                })
+                | std::ranges::to<std::vector>();
+
+            std::vector<vk::ShaderEXT> spirv_shaders(spirv_indices.size());
+            auto result = device.createShadersEXT(
+                static_cast<uint32_t>(spirv_create_infos.size()), spirv_create_infos.data(), nullptr, spirv_shaders.data());
+
+            for (auto [idx, shader] : std::views::zip(spirv_indices, spirv_shaders))
+                shaders[idx] = shader;
+
+            if (result != vk::Result::eSuccess)
+                throw detailed_exception("Failed to create shader object: {}", vk::to_string(result));
+        }
+
+        for (uint32_t idx : entry_point_indices) {
+            auto& push_constants = root_layout.entry_push_constants(idx);
+
+            entry_points.push_back(shader_entry_point {
+                .pipeline_layout = layouts->acquire_pipeline_layout(set_layouts[idx], push_constants),
+                .push_constant_range = push_constants[0],
+                .shader_ext = shaders[idx],
+                .stage = root_layout.entry_points[idx].shader_stage
+            });
+        }
+
+        spdlog::debug("Created {} shader objects in {:.3f} ms, {} from driver binaries",
+            entry_point_count,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+            entry_point_count - spirv_indices.size());
+
+        if (refresh_binaries && binary_cache.enabled())
+            binary_cache.store(cache_key, shaders
+                | std::views::transform([&](vk::ShaderEXT shader) { return device.getShaderBinaryDataEXT(shader); })
+                | std::ranges::to<std::vector<std::vector<uint8_t>>>());
+    } catch (...) {
+        for (auto shader : shaders)
+            if (shader)
+                device.destroyShaderEXT(shader);
+        for (const auto& entry_point : entry_points)
+            layouts->release_pipeline_layout(entry_point.pipeline_layout);
+        throw;
+    }
 
     return shader_program {
         .root_layout = root_layout,
-        .entry_points = shader_objects | std::ranges::to<std::vector<shader_entry_point>>()
+        .entry_points = std::move(entry_points)
     };
 }
 
-void shader_manager::setup_slang_session() {
-    slang::createGlobalSession(global_session.writeRef());
+void shader_manager::destroy_shader_program(vk::Device device, layout_cache& layouts, const shader_program& program) {
+    for (const auto& entry_point : program.entry_points) {
+        device.destroyShaderEXT(entry_point.shader_ext);
+        layouts.release_pipeline_layout(entry_point.pipeline_layout);
+    }
+
+    release_descriptor_set_layouts(layouts, program.root_layout);
+}
+
+shader_manager::compile_context shader_manager::create_compile_context() const {
+    compile_context context;
 
-    target_desc = {
+    slang::createGlobalSession(context.global_session.writeRef());
+    create_session(context);
+
+    return context;
+}
+
+void shader_manager::create_session(compile_context& context) const {
+    context.source_generation = source_generation;
+
+    slang::TargetDesc target_desc = {
         .format = SLANG_SPIRV,
-        .profile = global_session->findProfile("spirv_1_6"),
+        .profile = context.global_session->findProfile(SHADER_TARGET_PROFILE),
         .forceGLSLScalarBufferLayout = false
     };
 
@@ -212,7 +743,7 @@ void shader_manager::setup_slang_session() {
     std::string shader_dir(VKENGINE_SHADER_DIR);
 	std::array<const char*, 1> search_paths = { shader_dir.c_str() };
 
-    session_desc = {
+    slang::SessionDesc session_desc = {
         .targets = &target_desc,
         .targetCount = 1,
 		.searchPaths = search_paths.data(),
@@ -221,15 +752,51 @@ void shader_manager::setup_slang_session() {
         .compilerOptionEntryCount = static_cast<uint32_t>(compiler_option_entries.size()),
     };
 
-    global_session->createSession(session_desc, session.writeRef());
-}
+    context.session = nullptr;
+    context.global_session->createSession(session_desc, context.session.writeRef());
 
-void shader_manager::create_subgroup_module() {
-    std::string subgroup_module_src = fmt::format("export static const uint SUBGROUP_SIZE = {};", vulkan.get().gpu().subgroup_properties.subgroupSize);
-    subgroup_module = session->loadModuleFromSourceString("subgroup_size", "subgroup_size.slang", subgroup_module_src.c_str());
+    context.subgroup_module = context.session->loadModuleFromSourceString("subgroup_size", "subgroup_size.slang", subgroup_module_source.c_str());
 
-    if (!subgroup_module)
+    if (!context.subgroup_module)
         throw std::runtime_error("Failed to create subgroup module");
+
+    // Loaded in bundle order so that imports resolve to the already loaded modules instead of searching the disk
+    context.embedded_modules.clear();
+    if (use_embedded_modules())
+        for (const auto& embedded : embedded_shader_modules()) {
+            std::string module_name(embedded.name);
+            std::string module_path = module_name + ".slang-module";
+
+            Slang::ComPtr<slang::IModule> module(context.session->loadModuleFromIRBlob(
+                module_name.c_str(),
+                module_path.c_str(),
+                &embedded_module_blob(embedded),
+                context.diagnostics.writeRef()));
+
+            if (!module)
+                throw_exception_with_slang_diagnostics(context, "Failed to load embedded shader module: " + module_name);
+
+            context.embedded_modules.emplace(embedded.name, std::move(module));
+        }
+}
+
+bool shader_manager::use_embedded_modules() const {
+    return !hot_reload_enabled && !embedded_shader_modules().empty();
+}
+
+// Brings the session up to date with the sources on disk, modules are otherwise only ever loaded once
+shader_manager::compile_context& shader_manager::current(compile_context& context) const {
+    if (context.source_generation != source_generation)
+        create_session(context);
+    return context;
+}
+
+// Only ever called from the worker that owns 'worker_index', so creating the context lazily needs no lock
+shader_manager::compile_context& shader_manager::worker_context(uint32_t worker_index) {
+    auto& context = worker_contexts[worker_index];
+    if (!context)
+        context = std::make_unique<compile_context>(create_compile_context());
+    return current(*context);
 }
 
 }
\ No newline at end of file
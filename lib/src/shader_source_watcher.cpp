@@ -0,0 +1,124 @@
+#include <shader_source_watcher.hpp>
+#include <detailed_exception.hpp>
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+namespace vkengine {
+
+#ifdef __linux__
+
+namespace {
+
+constexpr uint32_t WATCH_EVENT_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+}
+
+shader_source_watcher::shader_source_watcher(
+    std::filesystem::path directory,
+    callback on_change,
+    std::chrono::milliseconds settle_time
+)
+    : on_change_(std::move(on_change)),
+    settle_time_(settle_time) {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0)
+        throw detailed_exception("Failed to initialise inotify: {}", std::strerror(errno));
+
+    try {
+        add_watch(directory);
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+            if (entry.is_directory())
+                add_watch(entry.path());
+    } catch (...) {
+        close(inotify_fd_);
+        throw;
+    }
+
+    spdlog::info("Watching {} for shader changes", directory.string());
+
+    thread_ = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+shader_source_watcher::~shader_source_watcher() {
+    thread_.request_stop();
+    if (thread_.joinable())
+        thread_.join();
+    close(inotify_fd_);
+}
+
+void shader_source_watcher::add_watch(const std::filesystem::path& directory) {
+    int watch = inotify_add_watch(inotify_fd_, directory.c_str(), WATCH_EVENT_MASK);
+    if (watch < 0)
+        throw detailed_exception("Failed to watch {}: {}", directory.string(), std::strerror(errno));
+
+    watched_directories_[watch] = directory;
+}
+
+// Polls with a short timeout so that a stop request is noticed without having to wake the read
+void shader_source_watcher::run(std::stop_token stop) {
+    constexpr int POLL_TIMEOUT_MS = 50;
+
+    std::set<std::filesystem::path> changed_files;
+    auto last_event = std::chrono::steady_clock::now();
+
+    alignas(inotify_event) char buffer[4096];
+
+    while (!stop.stop_requested()) {
+        pollfd poll_fd = { .fd = inotify_fd_, .events = POLLIN, .revents = 0 };
+        int ready = poll(&poll_fd, 1, POLL_TIMEOUT_MS);
+
+        if (ready > 0) {
+            ssize_t length;
+            while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+                for (char* cursor = buffer; cursor < buffer + length;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(cursor);
+                    cursor += sizeof(inotify_event) + event->len;
+
+                    if (event->len == 0)
+                        continue;
+
+                    auto directory = watched_directories_.find(event->wd);
+                    if (directory == watched_directories_.end())
+                        continue;
+
+                    std::filesystem::path path = directory->second / event->name;
+                    if (path.extension() == ".slang")
+                        changed_files.insert(path.lexically_normal());
+                }
+            }
+            last_event = std::chrono::steady_clock::now();
+        }
+
+        if (!changed_files.empty() && std::chrono::steady_clock::now() - last_event >= settle_time_) {
+            try {
+                on_change_(changed_files);
+            } catch (const std::exception& e) {
+                spdlog::error("Shader change handler failed: {}", e.what());
+            }
+            changed_files.clear();
+        }
+    }
+}
+
+#else
+
+shader_source_watcher::shader_source_watcher(std::filesystem::path, callback, std::chrono::milliseconds) {
+    throw detailed_exception("Shader hot reload needs inotify and is only available on Linux");
+}
+
+shader_source_watcher::~shader_source_watcher() = default;
+
+void shader_source_watcher::add_watch(const std::filesystem::path&) {}
+void shader_source_watcher::run(std::stop_token) {}
+
+#endif
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+namespace vkengine {
+
+// Watches a shader directory (and the subdirectories that exist when it starts) with inotify.
+// Editors tend to emit several events per save, so changes are reported in batches once the
+// directory has been quiet for 'settle_time'. The callback runs on the watcher thread.
+class shader_source_watcher {
+public:
+    using callback = std::function<void(const std::set<std::filesystem::path>& changed_files)>;
+
+    shader_source_watcher(
+        std::filesystem::path directory,
+        callback on_change,
+        std::chrono::milliseconds settle_time = std::chrono::milliseconds(100)
+    );
+    ~shader_source_watcher();
+
+    shader_source_watcher(const shader_source_watcher&) = delete;
+    shader_source_watcher& operator=(const shader_source_watcher&) = delete;
+private:
+    void add_watch(const std::filesystem::path& directory);
+    void run(std::stop_token stop);
+
+    int                                             inotify_fd_ = -1;
+    std::unordered_map<int, std::filesystem::path>  watched_directories_;
+    callback                                        on_change_;
+    std::chrono::milliseconds                       settle_time_;
+    std::jthread                                    thread_;
+};
+
+}
@@ -2,6 +2,7 @@
 
 #include <detailed_exception.hpp>
 #include <slang.h>
+#include <cstring>
 #include <source_location>
 
 namespace vkengine {
@@ -11,4 +12,33 @@ void throw_on_slang_error(SlangResult result, std::source_location& source) {
         throw detailed_exception(source, "Got slang error code: {}", result);
 }
 
-}
\ No newline at end of file
+// Exposes memory that outlives every session, such as the embedded shader bundle, to Slang without copying it.
+// Reference counting is a no-op since the blob does not own anything.
+class static_blob : public ISlangBlob {
+public:
+    static_blob(const void* data, size_t size) : data_(data), size_(size) {}
+
+    SLANG_NO_THROW SlangResult SLANG_MCALL queryInterface(const SlangUUID& uuid, void** out_object) override {
+        const SlangUUID blob_uuid = ISlangBlob::getTypeGuid();
+        const SlangUUID unknown_uuid = ISlangUnknown::getTypeGuid();
+
+        if (std::memcmp(&uuid, &blob_uuid, sizeof(SlangUUID)) == 0 || std::memcmp(&uuid, &unknown_uuid, sizeof(SlangUUID)) == 0) {
+            *out_object = static_cast<ISlangBlob*>(this);
+            return SLANG_OK;
+        }
+
+        *out_object = nullptr;
+        return SLANG_E_NO_INTERFACE;
+    }
+
+    SLANG_NO_THROW uint32_t SLANG_MCALL addRef() override { return 1; }
+    SLANG_NO_THROW uint32_t SLANG_MCALL release() override { return 1; }
+
+    SLANG_NO_THROW const void* SLANG_MCALL getBufferPointer() override { return data_; }
+    SLANG_NO_THROW size_t SLANG_MCALL getBufferSize() override { return size_; }
+private:
+    const void* data_;
+    size_t      size_;
+};
+
+}
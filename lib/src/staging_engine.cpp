@@ -0,0 +1,268 @@
+#include <vulkan/vulkan.hpp>
+#include <staging_engine.hpp>
+#include <detailed_exception.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace vkengine {
+
+namespace {
+
+constexpr vk::DeviceSize COPY_ALIGNMENT = 16;
+
+vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+staging_engine::staging_engine(
+    std::reference_wrapper<allocator> alloc,
+    const vulkan_core& core,
+    vk::DeviceSize capacity,
+    uint32_t slots
+) : allocator_(alloc), core_(core) {
+    spdlog::trace("Constructing {}", typeid(*this).name());
+
+    if (slots == 0)
+        throw detailed_exception("The staging engine needs at least one slot");
+
+    slot_size_ = capacity / slots / COPY_ALIGNMENT * COPY_ALIGNMENT;
+    if (slot_size_ == 0)
+        throw detailed_exception("Staging capacity of {} bytes is too small for {} slots", capacity, slots);
+
+    queue_families_.push_back(core_.transfer_queue_family());
+    if (core_.compute_queue_family() != core_.transfer_queue_family())
+        queue_families_.push_back(core_.compute_queue_family());
+
+    auto device = core_.device();
+
+    auto semaphore_type_info = vk::SemaphoreTypeCreateInfo()
+        .setSemaphoreType(vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+    timeline_semaphore_ = device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&semaphore_type_info));
+
+    // Random access rather than sequential write, downloads read the staging memory back on the host
+    allocation_tag tag("staging_engine");
+    staging_ = allocator_.get().create_buffer(
+        vk::BufferCreateInfo()
+            .setSize(slot_size_ * slots)
+            .setUsage(vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst),
+        VmaAllocationCreateInfo {
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO
+        });
+
+    auto cmd_buffers = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo()
+            .setCommandPool(core_.transfer_command_pool())
+            .setCommandBufferCount(slots));
+
+    slots_.resize(slots);
+    for (uint32_t i = 0; i < slots; ++i) {
+        slots_[i].cmd_buffer = cmd_buffers[i];
+        slots_[i].offset = i * slot_size_;
+    }
+
+    completion_thread_ = std::jthread([this](std::stop_token stop) { complete(stop); });
+}
+
+staging_engine::~staging_engine() {
+    spdlog::trace("Destructing {}", typeid(*this).name());
+
+    // The completion thread finishes the submissions still in flight before it exits
+    completion_thread_.request_stop();
+    completion_thread_.join();
+
+    auto device = core_.device();
+    for (auto& slot : slots_)
+        device.freeCommandBuffers(core_.transfer_command_pool(), slot.cmd_buffer);
+    allocator_.get().destroy_buffer(staging_);
+    device.destroySemaphore(timeline_semaphore_);
+}
+
+std::span<const uint32_t> staging_engine::queue_families() const noexcept {
+    return queue_families_;
+}
+
+timeline_point staging_engine::last_submitted() const {
+    std::lock_guard lock(mutex_);
+    return { .semaphore = timeline_semaphore_, .value = timeline_value_ };
+}
+
+timeline_point staging_engine::record_upload(
+    std::span<const std::byte> data,
+    vk::Buffer destination,
+    std::shared_ptr<void> destination_owner,
+    completion on_complete
+) {
+    auto* mapped = static_cast<std::byte*>(staging_.allocation_info.pMappedData);
+
+    std::unique_lock lock(mutex_);
+
+    auto* slot = &begin_slot(lock);
+    vk::DeviceSize copied = 0;
+
+    while (copied < data.size()) {
+        if (slot->used == slot_size_) {
+            submit_slot(*slot);
+            slot = &begin_slot(lock);
+        }
+
+        auto size = std::min<vk::DeviceSize>(data.size() - copied, slot_size_ - slot->used);
+        auto staging_offset = slot->offset + slot->used;
+
+        std::memcpy(mapped + staging_offset, data.data() + copied, size);
+        allocator_.get().flush_buffer(staging_, staging_offset, size);
+        slot->cmd_buffer.copyBuffer(staging_.handle, destination, vk::BufferCopy(staging_offset, copied, size));
+        slot->completions.push_back([destination_owner](std::exception_ptr) {});
+
+        slot->used = std::min(slot_size_, align_up(slot->used + size, COPY_ALIGNMENT));
+        copied += size;
+    }
+
+    slot->completions.push_back(std::move(on_complete));
+    submit_slot(*slot);
+
+    return { .semaphore = timeline_semaphore_, .value = slot->timeline_value };
+}
+
+void staging_engine::record_download(
+    vk::Buffer source,
+    std::span<std::byte> destination,
+    std::shared_ptr<void> destination_owner,
+    std::optional<timeline_point> after,
+    completion on_complete
+) {
+    auto* mapped = static_cast<const std::byte*>(staging_.allocation_info.pMappedData);
+
+    std::unique_lock lock(mutex_);
+
+    auto begin_waiting_slot = [&]() -> slot& {
+        auto& slot = begin_slot(lock);
+        if (after)
+            slot.waits.push_back(after->wait_info(vk::PipelineStageFlagBits2::eTransfer));
+        return slot;
+    };
+
+    auto* slot = &begin_waiting_slot();
+    vk::DeviceSize copied = 0;
+
+    while (copied < destination.size()) {
+        if (slot->used == slot_size_) {
+            submit_slot(*slot);
+            slot = &begin_waiting_slot();
+        }
+
+        auto size = std::min<vk::DeviceSize>(destination.size() - copied, slot_size_ - slot->used);
+        auto staging_offset = slot->offset + slot->used;
+
+        slot->cmd_buffer.copyBuffer(source, staging_.handle, vk::BufferCopy(copied, staging_offset, size));
+        slot->completions.push_back([this, mapped, staging_offset, destination_owner, chunk = destination.subspan(copied, size)](std::exception_ptr error) {
+            if (error)
+                return;
+            allocator_.get().invalidate_buffer(staging_, staging_offset, chunk.size());
+            std::memcpy(chunk.data(), mapped + staging_offset, chunk.size());
+        });
+
+        slot->used = std::min(slot_size_, align_up(slot->used + size, COPY_ALIGNMENT));
+        copied += size;
+    }
+
+    slot->completions.push_back(std::move(on_complete));
+    submit_slot(*slot);
+}
+
+staging_engine::slot& staging_engine::begin_slot(std::unique_lock<std::mutex>& lock) {
+    auto& slot = slots_[current_slot_];
+    slot_freed_.wait(lock, [&] { return slot.state != slot_state::in_flight; });
+
+    if (slot.state == slot_state::free) {
+        slot.cmd_buffer.reset();
+        slot.cmd_buffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        slot.used = 0;
+        slot.state = slot_state::recording;
+    }
+
+    return slot;
+}
+
+void staging_engine::submit_slot(slot& slot) {
+    // Downloads are read on the host once the timeline value is reached
+    auto host_barrier = vk::MemoryBarrier2()
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+        .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+        .setDstAccessMask(vk::AccessFlagBits2::eHostRead);
+    slot.cmd_buffer.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(host_barrier));
+    slot.cmd_buffer.end();
+
+    auto cmd_buffer_info = vk::CommandBufferSubmitInfo().setCommandBuffer(slot.cmd_buffer);
+    auto signal_info = vk::SemaphoreSubmitInfo()
+        .setSemaphore(timeline_semaphore_)
+        .setValue(timeline_value_ + 1)
+        .setStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+
+    try {
+        core_.transfer_queue().submit2(
+            vk::SubmitInfo2()
+                .setWaitSemaphoreInfos(slot.waits)
+                .setCommandBufferInfos(cmd_buffer_info)
+                .setSignalSemaphoreInfos(signal_info));
+    } catch (...) {
+        for (auto& completion : slot.completions)
+            completion(std::current_exception());
+        slot.completions.clear();
+        slot.waits.clear();
+        slot.state = slot_state::free;
+        throw;
+    }
+
+    slot.timeline_value = ++timeline_value_;
+    slot.state = slot_state::in_flight;
+    in_flight_.push_back(current_slot_);
+    current_slot_ = (current_slot_ + 1) % slots_.size();
+
+    submitted_.notify_one();
+}
+
+void staging_engine::complete(std::stop_token stop) {
+    auto device = core_.device();
+
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        // Returns false only when stopping with nothing left in flight
+        if (!submitted_.wait(lock, stop, [&] { return !in_flight_.empty(); }))
+            return;
+
+        auto& slot = slots_[in_flight_.front()];
+        auto timeline_value = slot.timeline_value;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            auto wait_info = vk::SemaphoreWaitInfo()
+                .setSemaphores(timeline_semaphore_)
+                .setValues(timeline_value);
+            (void)device.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+        } catch (...) {
+            spdlog::error("Waiting for staging transfer {} failed", timeline_value);
+            error = std::current_exception();
+        }
+
+        // The slot is not touched by recording threads while it is in flight
+        for (auto& completion : slot.completions)
+            completion(error);
+
+        lock.lock();
+        slot.completions.clear();
+        slot.waits.clear();
+        slot.state = slot_state::free;
+        in_flight_.pop_front();
+        slot_freed_.notify_all();
+    }
+}
+
+}
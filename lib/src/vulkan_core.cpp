@@ -2,6 +2,7 @@
 #include <vulkan_core.hpp>
 #include <spdlog/spdlog.h>
 #include <detailed_exception.hpp>
+#include <algorithm>
 
 namespace vkengine {
 
@@ -83,7 +84,7 @@ uint32_t vulkan_core::find_graphics_family(const std::vector<vk::QueueFamilyProp
 }
 
 vulkan_core::vulkan_core(vk::Instance instance, const vkengine::gpu& gpu, std::vector<const char*> device_extensions)
-    : instance_(instance), gpu_(gpu) {
+    : instance_(instance), gpu_(gpu), enabled_extensions_(device_extensions.begin(), device_extensions.end()) {
 #ifdef APP_USE_VULKAN_DEBUG_UTILS
     debug_utils_messenger_ = instance_.createDebugUtilsMessengerEXT(
         vk::DebugUtilsMessengerCreateInfoEXT{}
@@ -128,7 +129,16 @@ vulkan_core::vulkan_core(vk::Instance instance, const vkengine::gpu& gpu, std::v
                 .setQueueCreateInfos(queue_create_infos)
                 .setPEnabledExtensionNames(device_extensions),
             vk::PhysicalDeviceFeatures2()
-                .setFeatures(vk::PhysicalDeviceFeatures().setShaderInt16(true)),
+                .setFeatures(vk::PhysicalDeviceFeatures()
+                    .setShaderInt16(true)
+                    .setShaderInt64(gpu_.features.features.shaderInt64)
+                    .setSparseBinding(gpu_.features.features.sparseBinding)),
+            vk::PhysicalDeviceShaderFloat16Int8Features()
+                .setShaderFloat16(gpu_.shader_float16_int8_features.shaderFloat16)
+                .setShaderInt8(gpu_.shader_float16_int8_features.shaderInt8),
+            vk::PhysicalDevice8BitStorageFeatures()
+                .setStorageBuffer8BitAccess(gpu_.storage_8bit_features.storageBuffer8BitAccess)
+                .setStoragePushConstant8(gpu_.storage_8bit_features.storagePushConstant8),
             vk::PhysicalDeviceTimelineSemaphoreFeatures()
                 .setTimelineSemaphore(true),
             vk::PhysicalDeviceDynamicRenderingFeatures()
@@ -140,6 +150,7 @@ vulkan_core::vulkan_core(vk::Instance instance, const vkengine::gpu& gpu, std::v
             vk::PhysicalDeviceSynchronization2Features()
                 .setSynchronization2(true),
             vk::PhysicalDevice16BitStorageFeatures()
+                .setStorageBuffer16BitAccess(true)
                 .setStoragePushConstant16(true),
             vk::PhysicalDeviceScalarBlockLayoutFeatures()
                 .setScalarBlockLayout(true)
@@ -191,7 +202,7 @@ vk::PhysicalDevice vulkan_core::physical_device() const {
 	return gpu_.physical_device;
 }
 
-gpu vulkan_core::gpu() const {
+const gpu& vulkan_core::gpu() const {
 	return gpu_;
 }
 
@@ -219,8 +230,24 @@ vk::Queue vulkan_core::compute_queue() const {
     return compute_queue_;
 }
 
+std::unique_lock<std::mutex> vulkan_core::lock_compute_queue() const {
+    return std::unique_lock(compute_queue_mutex_);
+}
+
+uint32_t vulkan_core::compute_queue_family() const {
+    return compute_queue_family_;
+}
+
 vk::Queue vulkan_core::transfer_queue() const {
     return transfer_queue_;
 }
 
-}
\ No newline at end of file
+uint32_t vulkan_core::transfer_queue_family() const {
+    return transfer_queue_family_;
+}
+
+bool vulkan_core::is_extension_enabled(std::string_view extension) const {
+    return std::ranges::find(enabled_extensions_, extension) != enabled_extensions_.end();
+}
+
+}
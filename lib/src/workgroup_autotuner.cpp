@@ -0,0 +1,145 @@
+#include <vulkan/vulkan.hpp>
+#include <workgroup_autotuner.hpp>
+#include <detailed_exception.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <bit>
+
+namespace vkengine {
+
+workgroup_autotuner::workgroup_autotuner(vulkan_core& core, shader_manager& shader_manager, uint32_t repetitions)
+    : core_(core),
+    shader_manager_(shader_manager),
+    repetitions_(std::max(1u, repetitions)) {
+    auto gpu = core_.gpu();
+
+    if (gpu.queue_family_properties[core_.compute_queue_family()].timestampValidBits == 0)
+        throw detailed_exception("The compute queue does not support timestamp queries");
+
+    timestamp_period_ns_ = gpu.properties.properties.limits.timestampPeriod;
+
+    auto device = core_.device();
+    cmd_buffer_ = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo()
+        .setCommandPool(core_.compute_command_pool())
+        .setCommandBufferCount(1))[0];
+    query_pool_ = device.createQueryPool(
+        vk::QueryPoolCreateInfo()
+        .setQueryType(vk::QueryType::eTimestamp)
+        .setQueryCount(2));
+    fence_ = device.createFence(vk::FenceCreateInfo());
+}
+
+workgroup_autotuner::~workgroup_autotuner() {
+    auto device = core_.device();
+    device.destroyFence(fence_);
+    device.destroyQueryPool(query_pool_);
+    device.freeCommandBuffers(core_.compute_command_pool(), cmd_buffer_);
+}
+
+workgroup_size workgroup_autotuner::tune(
+    const std::string& kernel,
+    std::span<const workgroup_size> candidates,
+    const record_function& record
+) {
+    auto timings = measure(candidates, record);
+    if (timings.empty())
+        throw detailed_exception("No workgroup size candidate of {} could be timed", kernel);
+
+    auto best = std::ranges::min(timings, {}, &candidate_timing::median_ms);
+
+    spdlog::info("Tuned {}: {}x{}x{} at {:.3f} ms", kernel, best.size.x, best.size.y, best.size.z, best.median_ms);
+    shader_manager_.workgroup_sizes().set(kernel, best.size);
+
+    return best.size;
+}
+
+std::vector<workgroup_autotuner::candidate_timing> workgroup_autotuner::measure(
+    std::span<const workgroup_size> candidates,
+    const record_function& record
+) {
+    std::vector<candidate_timing> timings;
+
+    for (const auto& size : candidates) {
+        std::vector<double> samples;
+        try {
+            // The first submission compiles the program and warms up caches and clocks, it is not counted
+            time_submission(record, size);
+            for (uint32_t repetition = 0; repetition < repetitions_; ++repetition)
+                samples.push_back(time_submission(record, size));
+        } catch (const std::exception& e) {
+            spdlog::warn("Skipping workgroup size {}x{}x{}: {}", size.x, size.y, size.z, e.what());
+            continue;
+        }
+
+        std::ranges::nth_element(samples, samples.begin() + samples.size() / 2);
+        timings.push_back(candidate_timing { .size = size, .median_ms = samples[samples.size() / 2] });
+
+        spdlog::debug("Workgroup size {}x{}x{}: {:.3f} ms", size.x, size.y, size.z, timings.back().median_ms);
+    }
+
+    return timings;
+}
+
+double workgroup_autotuner::time_submission(const record_function& record, workgroup_size size) {
+    auto device = core_.device();
+
+    cmd_buffer_.reset();
+    cmd_buffer_.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    cmd_buffer_.resetQueryPool(query_pool_, 0, 2);
+    cmd_buffer_.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, query_pool_, 0);
+
+    try {
+        record(cmd_buffer_, size);
+    } catch (...) {
+        cmd_buffer_.end();
+        throw;
+    }
+
+    cmd_buffer_.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, query_pool_, 1);
+    cmd_buffer_.end();
+
+    {
+        auto queue_lock = core_.lock_compute_queue();
+        core_.compute_queue().submit(vk::SubmitInfo().setCommandBuffers(cmd_buffer_), fence_);
+    }
+    if (device.waitForFences(fence_, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        throw detailed_exception("Timed out waiting for the tuning submission");
+    device.resetFences(fence_);
+
+    auto [result, timestamps] = device.getQueryPoolResults<uint64_t>(
+        query_pool_, 0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+    if (result != vk::Result::eSuccess)
+        throw detailed_exception("Failed to read timestamps: {}", vk::to_string(result));
+
+    return static_cast<double>(timestamps[1] - timestamps[0]) * timestamp_period_ns_ * 1e-6;
+}
+
+std::vector<workgroup_size> workgroup_autotuner::candidates_1d(const gpu& gpu, uint32_t multiple_of, uint32_t max_invocations) {
+    const auto& limits = gpu.properties.properties.limits;
+    max_invocations = std::min({ max_invocations, limits.maxComputeWorkGroupInvocations, limits.maxComputeWorkGroupSize[0] });
+
+    std::vector<workgroup_size> candidates;
+    for (uint32_t x = std::bit_ceil(std::max(1u, multiple_of)); x <= max_invocations; x *= 2)
+        if (x % multiple_of == 0 && x >= 32)
+            candidates.push_back({ .x = x });
+
+    return candidates;
+}
+
+std::vector<workgroup_size> workgroup_autotuner::candidates_2d(const gpu& gpu, uint32_t max_invocations) {
+    const auto& limits = gpu.properties.properties.limits;
+    max_invocations = std::min(max_invocations, limits.maxComputeWorkGroupInvocations);
+
+    std::vector<workgroup_size> candidates;
+    for (uint32_t x = 4; x <= limits.maxComputeWorkGroupSize[0]; x *= 2)
+        for (uint32_t y = 1; y <= limits.maxComputeWorkGroupSize[1]; y *= 2)
+            if (x * y >= 32 && x * y <= max_invocations)
+                candidates.push_back({ .x = x, .y = y });
+
+    return candidates;
+}
+
+}
@@ -0,0 +1,86 @@
+#include <workgroup_tuning.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace vkengine {
+
+workgroup_tuning::workgroup_tuning(std::filesystem::path directory, const gpu& gpu) {
+    if (directory.empty())
+        return;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        spdlog::warn("Not persisting workgroup tuning, failed to create {}: {}", directory.string(), error.message());
+        return;
+    }
+
+    file_ = directory / fmt::format("{:02x}_{:08x}.txt",
+        fmt::join(gpu.id_properties.deviceUUID, ""),
+        gpu.properties.properties.driverVersion);
+
+    std::ifstream in(file_);
+    for (std::string line; std::getline(in, line);) {
+        std::istringstream fields(line);
+        std::string kernel;
+        workgroup_size size;
+        if (fields >> kernel >> size.x >> size.y >> size.z && size.invocations() > 0)
+            sizes_[kernel] = size;
+    }
+
+    if (!sizes_.empty())
+        spdlog::info("Loaded {} tuned workgroup sizes from {}", sizes_.size(), file_.string());
+}
+
+std::optional<workgroup_size> workgroup_tuning::find(const std::string& kernel) const {
+    std::lock_guard lock(mutex_);
+    if (auto it = sizes_.find(kernel); it != sizes_.end())
+        return it->second;
+    return std::nullopt;
+}
+
+workgroup_size workgroup_tuning::get(const std::string& kernel, workgroup_size fallback) const {
+    return find(kernel).value_or(fallback);
+}
+
+void workgroup_tuning::set(const std::string& kernel, workgroup_size size) {
+    std::lock_guard lock(mutex_);
+    sizes_[kernel] = size;
+    save();
+}
+
+const std::filesystem::path& workgroup_tuning::file() const noexcept {
+    return file_;
+}
+
+// Written to a temporary file first so that a crash never leaves a half written file behind
+void workgroup_tuning::save() const {
+    if (file_.empty())
+        return;
+
+    auto temp_path = file_;
+    temp_path += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        for (const auto& [kernel, size] : sizes_)
+            out << kernel << ' ' << size.x << ' ' << size.y << ' ' << size.z << '\n';
+
+        if (!out) {
+            spdlog::warn("Failed to write workgroup tuning to {}", temp_path.string());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, file_, error);
+    if (error) {
+        spdlog::warn("Failed to write workgroup tuning to {}: {}", file_.string(), error.message());
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+}
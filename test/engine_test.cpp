@@ -0,0 +1,174 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_manager.hpp>
+#include <compute_recorder.hpp>
+#include <argument_ring.hpp>
+#include <algorithms/normalise.hpp>
+#include "test_context.hpp"
+
+#include <array>
+#include <iostream>
+#include <string_view>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+    if (condition)
+        return;
+    std::cout << "FAIL: " << what << std::endl;
+    failures++;
+}
+
+// Recording the same normalise twice binds and pushes once, changing one push constant pushes only its bytes.
+// float to float has no padding in its push constants, padding bytes would defeat the elision.
+void check_recorder_elision(test_context::device_state& state, vkengine::shader_manager& shader_manager, vk::CommandBuffer cmd_buffer) {
+    vkengine::device_buffer<float> input(state.allocator, state.core, uint64_t(1024));
+    vkengine::device_buffer<float> output(state.allocator, state.core, uint64_t(1024));
+
+    cmd_buffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    vkengine::compute_recorder recorder(cmd_buffer);
+
+    vkengine::normalise<float, float>(input, output, 0.0f, 65535.0f, 0.0f, 1.0f, shader_manager, recorder);
+    auto first = recorder.stats();
+    check(first.shader_binds == 1 && first.push_constant_updates == 1 && first.dispatches == 1, "first normalise is recorded in full");
+
+    vkengine::normalise<float, float>(input, output, 0.0f, 65535.0f, 0.0f, 1.0f, shader_manager, recorder);
+    auto repeated = recorder.stats();
+    check(repeated.shader_binds == 1 && repeated.shader_binds_elided == 1, "repeated bind is elided");
+    check(repeated.push_constant_updates == 1 && repeated.push_constant_updates_elided == 1, "repeated push constants are elided");
+    check(repeated.dispatches == 2, "repeated normalise still dispatches");
+
+    vkengine::normalise<float, float>(input, output, 0.0f, 65535.0f, 0.0f, 2.0f, shader_manager, recorder);
+    auto changed = recorder.stats();
+    check(changed.push_constant_updates == 2, "changed push constants are pushed");
+    check(changed.push_constant_bytes - repeated.push_constant_bytes == sizeof(float), "only the changed push constant is pushed");
+
+    recorder.invalidate();
+    vkengine::normalise<float, float>(input, output, 0.0f, 65535.0f, 0.0f, 2.0f, shader_manager, recorder);
+    check(recorder.stats().shader_binds == 2, "invalidate() forgets the bound shader");
+
+    cmd_buffer.end();
+}
+
+// Arguments that do not fit before the end of the ring wrap to its start, once the timeline semaphore has passed
+// the value the space was retired with
+void check_ring_wrap(test_context::device_state& state) {
+    auto device = state.core.device();
+    auto type_info = vk::SemaphoreTypeCreateInfo().setSemaphoreType(vk::SemaphoreType::eTimeline);
+    auto timeline_semaphore = device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&type_info));
+
+    {
+        vkengine::argument_ring ring(state.allocator, state.core, timeline_semaphore, 64);
+        check(ring.capacity() == 64, "ring capacity");
+
+        std::array<uint32_t, 4> small {};
+        auto first = ring.write(small);
+        auto second = ring.write(small);
+        ring.write(small);
+        check(second.span == first.span + 16 && ring.in_use() == 48, "arguments are written linearly");
+
+        ring.retire(1);
+        check(ring.in_use() == 48, "retired arguments stay in use until the semaphore passes them");
+
+        device.signalSemaphore(vk::SemaphoreSignalInfo().setSemaphore(timeline_semaphore).setValue(1));
+
+        // 32 bytes do not fit the 16 left at the end
+        std::array<uint32_t, 8> large {};
+        auto wrapped = ring.write(large);
+        check(wrapped.span == first.span, "arguments wrap to the start of the ring");
+        check(ring.in_use() == 48, "the first submission is reclaimed, the skipped end counts as padding");
+
+        ring.retire(2);
+        device.signalSemaphore(vk::SemaphoreSignalInfo().setSemaphore(timeline_semaphore).setValue(2));
+        ring.retire(3);
+        check(ring.in_use() == 0, "retire() reclaims completed submissions");
+    }
+
+    device.destroySemaphore(timeline_semaphore);
+}
+
+// Growing reallocates with at least 1.5 times the capacity, shrinking keeps it until shrink_to_fit()
+void check_resize_capacity(test_context::device_state& state) {
+    vkengine::device_buffer<float> buffer(state.allocator, state.core, uint64_t(100));
+    check(buffer.size() == 100 && buffer.capacity() == 100, "new buffers have no spare capacity");
+
+    buffer.resize(120);
+    check(buffer.size() == 120 && buffer.capacity() == 150, "growing a little grows by the growth factor");
+
+    auto address = buffer.device_address();
+    buffer.resize(140);
+    check(buffer.capacity() == 150 && buffer.device_address() == address, "resizing within the capacity does not reallocate");
+
+    buffer.resize(1000);
+    check(buffer.capacity() == 1000, "growing a lot grows to the requested size");
+
+    buffer.resize(10);
+    check(buffer.size() == 10 && buffer.capacity() == 1000, "shrinking keeps the capacity");
+
+    buffer.shrink_to_fit();
+    check(buffer.capacity() == 10, "shrink_to_fit() releases the spare capacity");
+
+    buffer.reserve(20);
+    check(buffer.size() == 10 && buffer.capacity() == 20, "reserve() keeps the size");
+}
+
+// Subviews address their region in place through the strides of the whole buffer
+void check_subview(test_context::device_state& state) {
+    vkengine::device_buffer_nd<float, 2> frame(state.allocator, state.core, { 480, 640 });
+    auto base = frame.device_address();
+
+    auto tile = frame.subview({ 16, 32 }, { 64, 128 });
+    auto tile_span = tile.as_mdspan();
+    check(tile_span.span == base + (16 * 640 + 32) * sizeof(float), "subview offset");
+    check(tile_span.strides == std::array<uint64_t, 2>{ 640, 1 } && tile.shape() == std::array<uint32_t, 2>{ 64, 128 },
+        "subview keeps the buffer's strides");
+    check(!tile.is_contiguous(), "a tile is not contiguous");
+
+    auto nested = tile.subview({ 1, 2 }, { 8, 8 });
+    check(nested.as_mdspan().span == base + (17 * 640 + 34) * sizeof(float), "nested subview offset");
+
+    auto band = frame.subview({ 16, 0 }, { 64, 640 });
+    check(band.is_contiguous() && band.as_span().span == base + 16 * 640 * sizeof(float) && band.as_span().size == 64 * 640,
+        "a band of whole rows is contiguous");
+
+    bool threw = false;
+    try {
+        (void)frame.subview({ 470, 0 }, { 16, 640 });
+    } catch (const vkengine::detailed_exception&) {
+        threw = true;
+    }
+    check(threw, "subviews past the buffer are rejected");
+}
+
+}
+
+// Usage: engine_test [device name filter, e.g. llvmpipe]
+// Checks the host side bookkeeping of the engine: compute_recorder elision, argument_ring recycling,
+// typed_buffer capacity and subview addressing.
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    test_context::device_state state(instance, gpu);
+    vkengine::shader_manager shader_manager(state.core);
+
+    auto device = state.core.device();
+    auto cmd_buffer = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo()
+        .setCommandPool(state.core.compute_command_pool())
+        .setCommandBufferCount(1))[0];
+
+    check_recorder_elision(state, shader_manager, cmd_buffer);
+    check_ring_wrap(state);
+    check_resize_capacity(state);
+    check_subview(state);
+
+    device.freeCommandBuffers(state.core.compute_command_pool(), cmd_buffer);
+
+    std::cout << (failures == 0 ? "PASS" : "FAIL") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
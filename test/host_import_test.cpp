@@ -0,0 +1,107 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_manager.hpp>
+#include <algorithms/normalise.hpp>
+#include "test_context.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <new>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+// std::aligned_alloc is not available on MSVC, aligned operator new is
+struct aligned_delete {
+    size_t alignment;
+    void operator()(void* p) const { ::operator delete(p, std::align_val_t(alignment)); }
+};
+
+template<typename T>
+std::unique_ptr<T[], aligned_delete> aligned_host_memory(size_t count, size_t alignment) {
+    size_t bytes = (count * sizeof(T) + alignment - 1) / alignment * alignment;
+    return std::unique_ptr<T[], aligned_delete>(
+        static_cast<T*>(::operator new(bytes, std::align_val_t(alignment))), aligned_delete{ alignment });
+}
+
+}
+
+// Usage: host_import_test [device name filter, e.g. llvmpipe]
+// Normalises a frame in imported host memory straight into imported host memory, then checks that unaligned
+// memory falls back to a copy.
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    test_context::device_state state(instance, gpu);
+    vkengine::shader_manager shader_manager(state.core);
+
+    auto alignment = state.allocator.host_import_alignment();
+    if (alignment == 0) {
+        std::cout << "The device does not support " << VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME << std::endl;
+        return 1;
+    }
+    std::cout << "Import alignment: " << alignment << " bytes" << std::endl;
+
+    // A multiple of the alignment for both element types
+    const uint32_t count = static_cast<uint32_t>(alignment) * 256;
+
+    auto input_memory = aligned_host_memory<uint16_t>(count, alignment);
+    auto output_memory = aligned_host_memory<float>(count, alignment);
+    for (uint32_t i = 0; i < count; ++i)
+        input_memory[i] = static_cast<uint16_t>(i);
+
+    auto input = vkengine::host_visible_buffer<uint16_t>::import_host_memory(
+        state.allocator, state.core, std::span(input_memory.get(), count));
+    auto output = vkengine::host_visible_buffer<float>::import_host_memory(
+        state.allocator, state.core, std::span(output_memory.get(), count));
+
+    int failures = 0;
+    if (!input.is_imported() || !output.is_imported()) {
+        std::cout << "FAIL: aligned memory was not imported" << std::endl;
+        failures++;
+    }
+
+    auto device = state.core.device();
+    auto cmd_buffer = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo()
+        .setCommandPool(state.core.compute_command_pool())
+        .setCommandBufferCount(1))[0];
+
+    cmd_buffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    vkengine::normalise<uint16_t, float>(input, output, uint16_t(0), uint16_t(65535), 0.0f, 1.0f, shader_manager, cmd_buffer);
+    cmd_buffer.end();
+
+    auto fence = device.createFence({});
+    state.core.compute_queue().submit(vk::SubmitInfo().setCommandBuffers(cmd_buffer), fence);
+    (void)device.waitForFences(fence, true, std::numeric_limits<uint64_t>::max());
+
+    // The kernel wrote the host memory directly
+    for (uint32_t i = 0; i < count; ++i) {
+        float expected = float(uint16_t(i)) / 65535.0f;
+        if (std::abs(output_memory[i] - expected) > 1e-5f) {
+            std::cout << "FAIL: output[" << i << "] = " << output_memory[i] << ", expected " << expected << std::endl;
+            failures++;
+            break;
+        }
+    }
+
+    // Off by one element, so never aligned
+    auto unaligned = vkengine::host_visible_buffer<uint16_t>::import_host_memory(
+        state.allocator, state.core, std::span(input_memory.get() + 1, count - 1));
+    if (unaligned.is_imported() || unaligned.mapping() == input_memory.get() + 1 || unaligned.mapping()[0] != input_memory[1]) {
+        std::cout << "FAIL: unaligned memory was not copied" << std::endl;
+        failures++;
+    }
+
+    unaligned.destroy();
+    input.destroy();
+    output.destroy();
+    device.destroyFence(fence);
+    device.freeCommandBuffers(state.core.compute_command_pool(), cmd_buffer);
+
+    std::cout << (failures == 0 ? "PASS" : "FAIL") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_manager.hpp>
+#include <workgroup_autotuner.hpp>
+#include <algorithms/convert_layout.hpp>
+#include <algorithms/median_filter.hpp>
+#include "test_context.hpp"
+
+#include <iostream>
+#include <string>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+// Median over the timestamps of 'repetitions' submissions, see workgroup_autotuner::measure
+double measure_ms(vkengine::workgroup_autotuner& autotuner, const vkengine::workgroup_autotuner::record_function& record) {
+    vkengine::workgroup_size size = vkengine::median_filter_operator<>::DEFAULT_WORKGROUP_SIZE;
+    auto timings = autotuner.measure(std::span(&size, 1), record);
+    if (timings.empty())
+        throw std::runtime_error("The submission could not be timed");
+    return timings[0].median_ms;
+}
+
+void print(const char* name, double ms, uint64_t bytes) {
+    std::cout << name << ": " << ms << " ms, " << double(bytes) / (ms * 1e6) << " GB/s" << std::endl;
+}
+
+}
+
+// Usage: layout_benchmark [device name filter, e.g. llvmpipe] [rows] [columns]
+// Median filters a large frame in linear and in tiled layout, and times the conversions between them.
+// Bandwidth counts one read and one write of the frame.
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    // Tall frames by default, where row-major neighbourhoods are furthest apart
+    uint32_t rows = argc > 2 ? std::stoul(argv[2]) : 16384;
+    uint32_t columns = argc > 3 ? std::stoul(argv[3]) : 4096;
+    std::cout << "Frame: " << rows << "x" << columns << std::endl;
+
+    test_context::device_state state(instance, gpu);
+    vkengine::shader_manager shader_manager(state.core);
+    vkengine::workgroup_autotuner autotuner(state.core, shader_manager);
+    vkengine::median_filter_operator<uint16_t> median_filter(shader_manager);
+
+    vkengine::device_buffer_nd<uint16_t, 2> linear_input(state.allocator, state.core, { rows, columns });
+    vkengine::device_buffer_nd<uint16_t, 2> linear_output(state.allocator, state.core, { rows, columns });
+    vkengine::tiled_device_buffer<uint16_t> tiled_input(state.allocator, state.core, { rows, columns });
+    vkengine::tiled_device_buffer<uint16_t> tiled_output(state.allocator, state.core, { rows, columns });
+
+    uint64_t bytes = 2 * linear_input.size_bytes();
+
+    print("median_filter linear", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        median_filter.record(linear_input, linear_output, cmd_buffer);
+    }), bytes);
+
+    print("median_filter tiled", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        median_filter.record(tiled_input, tiled_output, cmd_buffer);
+    }), bytes);
+
+    print("median_filter tiled to linear", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        median_filter.record(tiled_input, linear_output, cmd_buffer);
+    }), bytes);
+
+    print("convert linear to tiled", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        vkengine::convert_layout(linear_input, tiled_input, shader_manager, cmd_buffer);
+    }), bytes);
+
+    print("convert tiled to linear", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        vkengine::convert_layout(tiled_output, linear_output, shader_manager, cmd_buffer);
+    }), bytes);
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <vulkan/vulkan.hpp>
+#include <typed_buffer.hpp>
+#include "test_context.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct readback_timings {
+    double first_read_gbps;
+    double best_read_gbps;
+    bool cached;
+    bool coherent;
+};
+
+// The device writes the buffer with vkCmdFillBuffer, then the host sums it. The first read after the
+// submission includes the cache invalidation, later reads show the steady state bandwidth.
+template<vkengine::access_policy policy>
+readback_timings measure_readback(test_context::device_state& state, uint64_t count, uint32_t iterations) {
+    auto device = state.core.device();
+    vkengine::typed_buffer<uint32_t, 1, policy> buffer(state.allocator, state.core, count);
+
+    auto cmd_buffer = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo()
+        .setCommandPool(state.core.compute_command_pool())
+        .setCommandBufferCount(1))[0];
+
+    cmd_buffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    cmd_buffer.fillBuffer(buffer.vk_handle(), 0, VK_WHOLE_SIZE, 1);
+    auto barrier = vk::MemoryBarrier2()
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+        .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+        .setDstAccessMask(vk::AccessFlagBits2::eHostRead);
+    cmd_buffer.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(barrier));
+    cmd_buffer.end();
+
+    auto fence = device.createFence({});
+    state.core.compute_queue().submit(vk::SubmitInfo().setCommandBuffers(cmd_buffer), fence);
+    (void)device.waitForFences(fence, true, std::numeric_limits<uint64_t>::max());
+
+    double gigabytes = double(buffer.size_bytes()) / 1e9;
+    readback_timings timings{};
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        auto start = clock_type::now();
+        auto data = buffer.data();
+        uint64_t sum = std::accumulate(data.begin(), data.end(), uint64_t(0));
+        double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+        if (sum != count)
+            throw std::runtime_error("Read back unexpected contents");
+
+        double gbps = gigabytes / seconds;
+        if (i == 0)
+            timings.first_read_gbps = gbps;
+        timings.best_read_gbps = std::max(timings.best_read_gbps, gbps);
+    }
+
+    auto memory_properties = state.core.physical_device().getMemoryProperties();
+    auto flags = memory_properties.memoryTypes[buffer.memory_type()].propertyFlags;
+    timings.cached = bool(flags & vk::MemoryPropertyFlagBits::eHostCached);
+    timings.coherent = bool(flags & vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    buffer.destroy();
+    device.destroyFence(fence);
+    device.freeCommandBuffers(state.core.compute_command_pool(), cmd_buffer);
+    return timings;
+}
+
+void print(const char* name, const readback_timings& timings) {
+    std::cout << name << ": first read " << timings.first_read_gbps << " GB/s, best " << timings.best_read_gbps
+        << " GB/s (" << (timings.cached ? "cached" : "uncached") << ", "
+        << (timings.coherent ? "coherent" : "non-coherent") << ")" << std::endl;
+}
+
+}
+
+// Usage: readback_benchmark [device name filter, e.g. llvmpipe] [megabytes] [iterations]
+// Compares host read bandwidth of device written host_visible and host_readback buffers.
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    uint64_t megabytes = argc > 2 ? std::stoull(argv[2]) : 64;
+    uint32_t iterations = argc > 3 ? std::stoul(argv[3]) : 5;
+    uint64_t count = megabytes * (1 << 20) / sizeof(uint32_t);
+
+    test_context::device_state state(instance, gpu);
+
+    print("host_visible", measure_readback<vkengine::access_policy::host_visible>(state, count, iterations));
+    print("host_readback", measure_readback<vkengine::access_policy::host_readback>(state, count, iterations));
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_manager.hpp>
+#include <algorithms/inclusive_scan.hpp>
+#include <algorithms/histogram.hpp>
+#include <algorithms/normalise.hpp>
+#include <algorithms/median_filter.hpp>
+#include <typed_buffer.hpp>
+#include "test_context.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct startup_timings {
+    double session_ms;
+    double programs_ms;
+    vkengine::shader_cache::statistics cache;
+    vkengine::shader_binary_cache::statistics binary_cache;
+};
+
+double elapsed_ms(clock_type::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// Builds every operator's program the way the pipeline does at boot. With 'parallel' the programs
+// are compiled through warm_up() first, so the operators only pick up already loaded programs.
+startup_timings measure_startup(test_context::device_state& state, const std::filesystem::path& cache_dir, bool parallel) {
+    auto start = clock_type::now();
+    vkengine::shader_manager shader_manager(state.core, cache_dir);
+    double session_ms = elapsed_ms(start);
+
+    constexpr uint32_t width = 256, height = 256;
+
+    vkengine::device_buffer_nd<uint16_t, 2> image(state.allocator, state.core, { height, width });
+    vkengine::device_buffer<uint32_t> histogram(state.allocator, state.core, 1u << 16);
+    // The group sums are scanned by a single subgroup, which limits the scan to one group sum per lane
+    uint32_t subgroup_size = state.core.gpu().subgroup_properties.subgroupSize;
+    uint32_t scan_size = subgroup_size * vkengine::INCLUSIVE_SCAN_WORKGROUP_SIZE;
+    vkengine::device_buffer<uint32_t> scan_input(state.allocator, state.core, scan_size);
+    vkengine::device_buffer<uint32_t> scan_output(state.allocator, state.core, scan_size);
+    vkengine::device_buffer<uint32_t> group_sums(state.allocator, state.core, subgroup_size);
+    vkengine::device_buffer<uint16_t> normalised(state.allocator, state.core, scan_size);
+
+    auto cmd = state.core.device().allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo()
+        .setCommandPool(state.core.compute_command_pool())
+        .setCommandBufferCount(1))[0];
+    cmd.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    start = clock_type::now();
+    if (parallel) {
+        auto programs = shader_manager.warm_up({
+            vkengine::histogram_operator<uint16_t>::program_info(),
+            vkengine::median_filter_operator<uint16_t>::program_info(),
+            vkengine::inclusive_scan_program_info(),
+            vkengine::normalise_program_info<uint32_t, uint16_t>()
+        });
+        for (auto& program : programs)
+            program.wait();
+    }
+    vkengine::histogram_operator<uint16_t> histogram_op(shader_manager);
+    vkengine::median_filter_operator<uint16_t> median_filter_op(shader_manager);
+    vkengine::inclusive_scan(scan_input, scan_output, group_sums, shader_manager, cmd);
+    vkengine::normalise<uint32_t, uint16_t>(scan_output, normalised, 0u, scan_size, uint16_t(0), uint16_t(65535), shader_manager, cmd);
+    double programs_ms = elapsed_ms(start);
+
+    cmd.end();
+    state.core.device().freeCommandBuffers(state.core.compute_command_pool(), cmd);
+
+    image.destroy();
+    scan_input.destroy();
+    scan_output.destroy();
+    group_sums.destroy();
+    histogram.destroy();
+    normalised.destroy();
+
+    return startup_timings {
+        .session_ms = session_ms,
+        .programs_ms = programs_ms,
+        .cache = shader_manager.cache_statistics(),
+        .binary_cache = shader_manager.binary_cache_statistics()
+    };
+}
+
+void print_timings(const char* label, const startup_timings& timings) {
+    std::cout << label
+        << ": session " << timings.session_ms << " ms"
+        << ", programs " << timings.programs_ms << " ms"
+        << ", cache hits " << timings.cache.hits
+        << ", misses " << timings.cache.misses
+        << ", driver binary hits " << timings.binary_cache.hits
+        << ", misses " << timings.binary_cache.misses
+        << ", incompatible " << timings.binary_cache.incompatible << std::endl;
+}
+
+}
+
+// Usage: shader_cache_benchmark [device name filter, defaults to lavapipe's "llvmpipe"]
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "llvmpipe");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    test_context::device_state state(instance, gpu);
+
+    auto cache_dir = std::filesystem::temp_directory_path() / "vkengine_shader_cache_benchmark";
+    std::filesystem::remove_all(cache_dir);
+
+    auto cold = measure_startup(state, cache_dir, false);
+
+    // Without driver binaries a warm start still pays for the driver's SPIR-V compile, on lavapipe the LLVM JIT
+    std::filesystem::remove_all(cache_dir / "driver");
+    auto warm_spirv = measure_startup(state, cache_dir, false);
+    auto warm = measure_startup(state, cache_dir, false);
+
+    std::filesystem::remove_all(cache_dir);
+    auto cold_parallel = measure_startup(state, cache_dir, true);
+
+    print_timings("cold", cold);
+    print_timings("warm, SPIR-V only", warm_spirv);
+    print_timings("warm", warm);
+    print_timings("cold, parallel warm_up", cold_parallel);
+    std::cout << "warm speedup: " << cold.programs_ms / warm.programs_ms << "x" << std::endl;
+    std::cout << "driver binary speedup over SPIR-V only: " << warm_spirv.programs_ms / warm.programs_ms << "x" << std::endl;
+    std::cout << "parallel speedup on " << std::thread::hardware_concurrency() << " threads: "
+        << cold.programs_ms / cold_parallel.programs_ms << "x" << std::endl;
+
+    std::filesystem::remove_all(cache_dir);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan_core.hpp>
+#include <allocator.hpp>
+#include <gpu.hpp>
+#include <array>
+#include <iostream>
+#include <string_view>
+
+// Instance and device setup shared by the benchmark executables.
+// Each executable still has to provide VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE itself.
+namespace test_context {
+
+inline vk::Instance create_instance() {
+    VULKAN_HPP_DEFAULT_DISPATCHER.init();
+
+    std::vector<const char*> instance_extensions = { VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME };
+    std::vector<const char*> layers;
+#ifdef APP_USE_VULKAN_DEBUG_UTILS
+    layers.emplace_back("VK_LAYER_KHRONOS_validation");
+    instance_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+#endif
+
+    vk::ApplicationInfo app_info("vkengine benchmark", 1, "No Engine", 1, VK_API_VERSION_1_4);
+
+    vk::Instance instance = vk::createInstance(
+        vk::InstanceCreateInfo()
+        .setPApplicationInfo(&app_info)
+        .setPEnabledExtensionNames(instance_extensions)
+        .setPEnabledLayerNames(layers)
+    );
+    VULKAN_HPP_DEFAULT_DISPATCHER.init(instance);
+
+    return instance;
+}
+
+// Picks the first device whose name contains 'name_filter' (e.g. "llvmpipe" for lavapipe), falling back to the first device
+inline vkengine::gpu select_gpu(vk::Instance instance, std::string_view name_filter) {
+    auto gpus = vkengine::enumerate_gpus(instance);
+    if (gpus.empty())
+        throw std::runtime_error("No Vulkan devices found");
+
+    for (auto& gpu : gpus)
+        if (std::string_view(gpu.properties.properties.deviceName.data()).contains(name_filter))
+            return gpu;
+
+    std::cout << "No device matching '" << name_filter << "', using " << gpus[0].properties.properties.deviceName << std::endl;
+    return gpus[0];
+}
+
+// Optional extensions are enabled when the device has them
+inline std::vector<const char*> device_extensions(const vkengine::gpu& gpu) {
+    std::vector<const char*> extensions = {
+        VK_EXT_SHADER_OBJECT_EXTENSION_NAME,
+        VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+    };
+
+    // Used when available
+    const std::array optional_extensions = {
+        VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    };
+
+    for (const auto& extension : gpu.physical_device.enumerateDeviceExtensionProperties())
+        for (const char* name : optional_extensions)
+            if (std::string_view(extension.extensionName.data()) == name)
+                extensions.push_back(name);
+
+    return extensions;
+}
+
+struct device_state {
+    device_state(vk::Instance instance, const vkengine::gpu& gpu)
+        : core(instance, gpu, device_extensions(gpu)), allocator(core) { }
+
+    vkengine::vulkan_core core;
+    vkengine::allocator allocator;
+};
+
+}
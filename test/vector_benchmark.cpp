@@ -0,0 +1,83 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_manager.hpp>
+#include <workgroup_autotuner.hpp>
+#include <algorithms/histogram.hpp>
+#include <algorithms/normalise.hpp>
+#include "test_context.hpp"
+
+#include <iostream>
+#include <string>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+// Median over the timestamps of 'repetitions' submissions, see workgroup_autotuner::measure
+double measure_ms(vkengine::workgroup_autotuner& autotuner, const vkengine::workgroup_autotuner::record_function& record) {
+    vkengine::workgroup_size size = { .x = vkengine::NORMALISE_WORKGROUP_SIZE_X };
+    auto timings = autotuner.measure(std::span(&size, 1), record);
+    if (timings.empty())
+        throw std::runtime_error("The submission could not be timed");
+    return timings[0].median_ms;
+}
+
+void print(const char* name, double ms, uint64_t bytes) {
+    std::cout << name << ": " << ms << " ms, " << double(bytes) / (ms * 1e6) << " GB/s" << std::endl;
+}
+
+}
+
+// Usage: vector_benchmark [device name filter, e.g. llvmpipe] [elements]
+// Times normalise and histogram with four elements per thread (aligned spans) and with one (the same spans starting
+// one element in), against a plain buffer copy as the bandwidth ceiling. Bandwidth counts the bytes each pass
+// reads and writes, the histogram's atomics are not counted.
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    uint32_t elements = argc > 2 ? std::stoul(argv[2]) : 1u << 25;
+    std::cout << "Elements: " << elements << std::endl;
+
+    test_context::device_state state(instance, gpu);
+    vkengine::shader_manager shader_manager(state.core);
+    vkengine::workgroup_autotuner autotuner(state.core, shader_manager);
+    vkengine::histogram_operator<uint16_t> histogram(shader_manager);
+
+    vkengine::device_buffer<uint16_t> input(state.allocator, state.core, uint64_t(elements));
+    vkengine::device_buffer<float> output(state.allocator, state.core, uint64_t(elements));
+    vkengine::device_buffer<float> copy(state.allocator, state.core, uint64_t(elements));
+    vkengine::device_buffer<uint32_t> bins(state.allocator, state.core, uint64_t(1) << 16);
+
+    // One element in, so neither span is aligned to VECTOR_WIDTH elements and the kernels take one element per thread
+    vkengine::device_span unaligned_input = { input.device_address() + sizeof(uint16_t), elements - 1 };
+    vkengine::device_span unaligned_output = { output.device_address() + sizeof(float), elements - 1 };
+    // A contiguous view takes the 1D histogram kernel
+    vkengine::strided_view<uint16_t, 2> unaligned_view(input.vk_handle(), { unaligned_input.span, { 1, elements - 1 }, { elements - 1, 1 } });
+
+    print("copy", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        cmd_buffer.copyBuffer(output.vk_handle(), copy.vk_handle(), vk::BufferCopy(0, 0, output.size_bytes()));
+    }), 2 * output.size_bytes());
+
+    uint64_t normalise_bytes = input.size_bytes() + output.size_bytes();
+
+    print("normalise vectorised", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        vkengine::normalise<uint16_t, float>(input, output, uint16_t(0), uint16_t(65535), 0.0f, 1.0f, shader_manager, cmd_buffer);
+    }), normalise_bytes);
+
+    print("normalise scalar", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        vkengine::compute_recorder recorder(cmd_buffer);
+        vkengine::record_normalise<uint16_t, float>(unaligned_input, unaligned_output, uint16_t(0), uint16_t(65535), 0.0f, 1.0f,
+            shader_manager, recorder, std::nullopt);
+    }), normalise_bytes);
+
+    print("histogram vectorised", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        histogram.record(cmd_buffer, input, bins);
+    }), input.size_bytes());
+
+    print("histogram scalar", measure_ms(autotuner, [&](vk::CommandBuffer cmd_buffer, vkengine::workgroup_size) {
+        histogram.record(cmd_buffer, unaligned_view, bins);
+    }), input.size_bytes());
+
+    return 0;
+}
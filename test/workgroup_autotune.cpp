@@ -0,0 +1,32 @@
+#include <vulkan/vulkan.hpp>
+#include <shader_manager.hpp>
+#include <algorithms/autotune.hpp>
+#include "test_context.hpp"
+
+#include <iostream>
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+// Usage: workgroup_autotune [device name filter, defaults to the first device]
+// Tunes every operator and writes the results next to the default shader cache, where later runs pick them up.
+int main(int argc, char** argv) {
+    vk::Instance instance = test_context::create_instance();
+    vkengine::gpu gpu = test_context::select_gpu(instance, argc > 1 ? argv[1] : "");
+    std::cout << "Device: " << gpu.properties.properties.deviceName << std::endl;
+
+    test_context::device_state state(instance, gpu);
+    vkengine::shader_manager shader_manager(state.core);
+
+    vkengine::tune_operators(state.core, state.allocator, shader_manager);
+
+    for (const char* kernel : {
+        vkengine::histogram_operator<>::TUNING_KEY,
+        vkengine::median_filter_operator<>::TUNING_KEY,
+        vkengine::NORMALISE_TUNING_KEY,
+        vkengine::INCLUSIVE_SCAN_TUNING_KEY }) {
+        auto size = shader_manager.workgroup_sizes().get(kernel, {});
+        std::cout << kernel << ": " << size.x << "x" << size.y << "x" << size.z << std::endl;
+    }
+
+    std::cout << "Saved to " << shader_manager.workgroup_sizes().file().string() << std::endl;
+}